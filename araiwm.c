@@ -2,171 +2,163 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
 #include <xcb/xcb.h>
+#include <xcb/xcbext.h>
 #include <xcb/xcb_ewmh.h>
 #include <xcb/xcb_icccm.h>
 #include <xcb/xcb_keysyms.h>
-#include <X11/keysym.h>
-
-#include "config.h"
+#ifdef XINPUT
+#include <xcb/xinput.h>
+#endif
 
-#define LEN(A) sizeof(A)/sizeof(*A)
+#include "core.h"
+#include "prio.h"
+#include "trace.h"
 
 #define LOG(A) printf("araiwm: " A ".\n");
 
-enum { DEFAULT, MOVE, RESIZE, CYCLE, };
-enum { WM_PROTOCOLS, WM_DELETE_WINDOW, WM_COUNT, };
-enum { NET_SUPPORTED, NET_FULLSCREEN, NET_WM_STATE, NET_COUNT, };
-
-typedef struct window {
-	struct window *next;
-	struct window *prev;
-
-	xcb_window_t child;
-
-	xcb_rectangle_t snap;
-	int is_snap;
-	
-	xcb_rectangle_t full;	
-	int is_i_full;
-	int is_e_full;
-
-	int ignore_unmap;
-} window;
+enum { WM_PROTOCOLS, WM_DELETE_WINDOW, WM_WINDOW_ROLE, WM_COUNT, };
+enum {
+	NET_SUPPORTED,
+	NET_FULLSCREEN,
+	NET_WM_STATE,
+	NET_WM_PING,
+	NET_ABOVE,
+	NET_BELOW,
+	NET_RESTACK,
+	NET_WORKAREA,
+	NET_STRUT_PARTIAL,
+	NET_COUNT,
+};
+
+#define MAX_REPLIES 7
+
+//longest WM_WINDOW_ROLE read for rules, in 32 bit units
+#define ROLE_LEN 16
+
+/* milliseconds a closing client has to answer a ping before it is killed */
+#define PING_TIMEOUT 3000
+
+/* work left to do once the replies to some requests arrive */
+typedef struct {
+	unsigned int seq[MAX_REPLIES];
+	void *reply[MAX_REPLIES];
+	int len;
+	int got;
+
+	void (*func)(void **reply, xcb_window_t win);
+	xcb_window_t win;
+} continuation;
 
 static xcb_connection_t *conn;
 static xcb_ewmh_connection_t *ewmh;
-static xcb_screen_t *scr;
+
+//one connection manages every screen of the display
+static xcb_screen_t **screens = NULL;
+static int screens_len = 0;
 
 static xcb_atom_t wm_atoms[WM_COUNT];
 static xcb_atom_t net_atoms[NET_COUNT];
 
 static xcb_key_symbols_t *keysyms = NULL;
 
-static window *stack[NUM_WS] = { NULL };
-static window *fwin[NUM_WS] = { NULL };
+#ifdef XINPUT
+//zero when the server has no XInput2, drags then fall back to core events
+static uint8_t xi_opcode = 0;
+static xcb_input_device_id_t xi_pointer = 0;
 
-static unsigned int state = DEFAULT;
+//the drag runs on a device grab, until the server refuses one
+static int xi_drag = 0;
 
-static window *marker = NULL;
+//the last whole pixel handed to the core during a drag
+static int16_t drag_x = 0;
+static int16_t drag_y = 0;
+#endif
 
-static int curws = 0;
-static uint32_t x = 0;
-static uint32_t y = 0;
+static uint32_t enter_seq = 0;
+static int enter_fence = 0;
 
-static void insert(int ws, window *subj) {
-	subj->next = stack[ws];
-	subj->prev = NULL;
+static continuation *conts = NULL;
+static unsigned int conts_head = 0;
+static unsigned int conts_len = 0;
+static unsigned int conts_cap = 0;
 
-	if (stack[ws]) {
-		stack[ws]->prev = subj;
-	}
+typedef struct {
+	xcb_window_t win;
+	uint64_t deadline;
+} closing;
 
-	stack[ws] = subj;
-}
+static closing *closes = NULL;
+static unsigned int closes_len = 0;
+static unsigned int closes_cap = 0;
 
-static window *excise(int ws, window *subj) {
-	if (subj->next) {
-		subj->next->prev = subj->prev;
-	}
-	
-	if (subj->prev) {
-		subj->prev->next = subj->next;
-	} else {
-		stack[ws] = subj->next;
-	}
+static int timer = -1;
+static uint64_t wake = 0;
 
-	return subj;
-}
+//the signal that stopped us
+static volatile sig_atomic_t quit = 0;
 
-static window *ws_wtf(xcb_window_t id, int ws) {
-	window *cur;
-	for (cur = stack[ws]; cur; cur = cur->next) {
-		if (cur->child == id) {
-			break;
-		}
-	}
-	return cur;
-}
+//windows are left to the next window manager unless asked to close them
+static int close_windows = 0;
 
-static window *all_wtf(xcb_window_t id, int *ws) {
-	window *ret;
-	for (int i = 0; i < NUM_WS; i++) {
-		ret = ws_wtf(id, i);
-		if (ret) {
-			if (ws) {
-				*ws = i;
-			}
-			break;
-		}
-	}
-	return ret;
-}
+static const char *record = NULL;
+static const char *replay = NULL;
 
-static void ignore_unmap(window *subj) {
-	xcb_unmap_window(conn, subj->child);
-	subj->ignore_unmap = 1;
-}
+/* a replay stands its own windows in for the recorded ones, the core only sees recorded ids */
+typedef struct {
+	xcb_window_t recorded;
+	xcb_window_t win;
+} alias;
 
-static void map(window *subj) {
-	xcb_map_window(conn, subj->child);
-}
+static alias *aliases = NULL;
+static unsigned int aliases_len = 0;
+static unsigned int aliases_cap = 0;
 
-static void release_events(window *subj) {
-	uint32_t mask = XCB_CW_EVENT_MASK;
-	uint32_t val = XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_KEY_RELEASE;
-	xcb_change_window_attributes(conn, subj->child, mask, &val); 
-}
+//the class and role of the window adopted next
+static trace_names_t names;
 
-static void normal_events(window *subj) {
-	uint32_t mask = XCB_CW_EVENT_MASK;
-	uint32_t val = XCB_EVENT_MASK_ENTER_WINDOW;
-	xcb_change_window_attributes(conn, subj->child, mask, &val); 
-}
+static unsigned int replay_maps = 0;
+static unsigned int replay_adopted = 0;
+static unsigned int replay_managed = 0;
 
-static void move_resize(xcb_window_t win, int x, int y, int w, int h) {
-	uint32_t mask = XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT | XCB_CONFIG_WINDOW_X |
-			XCB_CONFIG_WINDOW_Y;
-	uint32_t vals[4];
-	vals[0] = x;
-	vals[1] = y;
-	vals[2] = w;
-	vals[3] = h;
-	xcb_configure_window(conn, win, mask, vals);
-}
+static void (*events[XCB_NO_OPERATION])(xcb_generic_event_t *event);
 
-static void move(xcb_window_t win, uint32_t x, uint32_t y) {
-	uint32_t mask = XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y;
-	uint32_t vals[2];
-	vals[0] = x;
-	vals[1] = y;
-	xcb_configure_window(conn, win, mask, vals);
-}
+//run carries out held back map requests, adoption comes further down
+static void start_adopt(xcb_window_t win, xcb_window_t parent);
 
-static void resize(xcb_window_t win, int w, int h) {
-	uint32_t mask = XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT;
-	uint32_t vals[2];
-	vals[0] = w;
-	vals[1] = h;
-	xcb_configure_window(conn, win, mask, vals);
+/* remember the latest request that may cause crossings, see ours */
+static void ignore_enter(xcb_void_cookie_t cookie) {
+	enter_seq = cookie.sequence;
+	enter_fence = 1;
 }
 
-static xcb_get_geometry_reply_t *w_get_geometry(xcb_window_t win) {
-	xcb_get_geometry_cookie_t cookie = xcb_get_geometry(conn, win);
-	return xcb_get_geometry_reply(conn, cookie, NULL);
-}
+static continuation *expect(void (*func)(void **reply, xcb_window_t win), xcb_window_t win) {
+	if (conts_len == conts_cap) {
+		if (conts_head) {
+			conts_len -= conts_head;
+			memmove(conts, conts + conts_head, conts_len * sizeof(continuation));
+			conts_head = 0;
+		} else {
+			conts_cap = conts_cap ? 2 * conts_cap : 16;
+			conts = realloc(conts, conts_cap * sizeof(continuation));
+		}
+	}
 
-static xcb_query_pointer_reply_t *w_query_pointer() {
-	xcb_query_pointer_cookie_t cookie = xcb_query_pointer(conn, scr->root);
-	return xcb_query_pointer_reply(conn, cookie, NULL);
+	continuation *cont = &conts[conts_len++];
+	memset(cont, 0, sizeof(continuation));
+	cont->func = func;
+	cont->win = win;
+	return cont;
 }
 
-static void traverse(window *list, void (*func)(window *)) {
-	for (; list;) {
-		window *temp = list;
-		list = temp->next;
-		func(temp);
-	}
+static void await(continuation *cont, unsigned int seq) {
+	cont->seq[cont->len++] = seq;
 }
 
 static void get_atoms(const char **names, xcb_atom_t *atoms, unsigned int count) {
@@ -183,605 +175,905 @@ static void get_atoms(const char **names, xcb_atom_t *atoms, unsigned int count)
 	}
 }
 
-static void grab_keys() {
-	xcb_key_symbols_free(keysyms);
+static int find_alias(xcb_window_t recorded) {
+	for (unsigned int i = 0; i < aliases_len; i++) {
+		if (aliases[i].recorded == recorded) {
+			return i;
+		}
+	}
+	return -1;
+}
 
-	keysyms = xcb_key_symbols_alloc(conn);
+static void add_alias(xcb_window_t recorded, xcb_window_t win) {
+	if (aliases_len == aliases_cap) {
+		aliases_cap = aliases_cap ? 2 * aliases_cap : 16;
+		aliases = realloc(aliases, aliases_cap * sizeof(alias));
+	}
+	aliases[aliases_len].recorded = recorded;
+	aliases[aliases_len].win = win;
+	aliases_len++;
+}
 
-	for (int i = 0; i < LEN(keys); i++) {
-		xcb_keycode_t *keycode = xcb_key_symbols_get_keycode(keysyms, keys[i].key);
-		xcb_grab_key(conn, 0, scr->root, keys[i].mod, *keycode, XCB_GRAB_MODE_ASYNC,
-				XCB_GRAB_MODE_ASYNC);
-		free(keycode);
+static xcb_window_t drop_alias(xcb_window_t recorded) {
+	int i = find_alias(recorded);
+	if (i < 0) {
+		return XCB_NONE;
 	}
+
+	xcb_window_t win = aliases[i].win;
+	aliases[i] = aliases[--aliases_len];
+	return win;
 }
 
-static void color(xcb_window_t win, uint32_t val) {
-	uint32_t mask = XCB_CW_BORDER_PIXEL;
-	xcb_change_window_attributes(conn, win, mask, &val);
+//ids a replay never adopted name none of its windows
+static xcb_window_t live(xcb_window_t win) {
+	if (!replay || win == XCB_NONE) {
+		return win;
+	}
+
+	int i = find_alias(win);
+	return i < 0 ? XCB_NONE : aliases[i].win;
+}
+
+static int screen_of(xcb_window_t root) {
+	for (int i = 0; i < screens_len; i++) {
+		if (screens[i]->root == root) {
+			return i;
+		}
+	}
+	return 0;
 }
 
-static void focus(window *subj) {
-	if (subj == fwin[curws]) {
+static void grab_key(uint16_t mod, xcb_keysym_t key) {
+	xcb_keycode_t *keycode = xcb_key_symbols_get_keycode(keysyms, key);
+	if (!keycode) {
 		return;
 	}
 
-	if (fwin[curws]) {
-		color(fwin[curws]->child, UNFOCUSCOL);
+	for (int i = 0; i < screens_len; i++) {
+		xcb_grab_key(conn, 0, screens[i]->root, mod, *keycode, XCB_GRAB_MODE_ASYNC,
+				XCB_GRAB_MODE_ASYNC);
 	}
+	free(keycode);
+}
 
-	color(subj->child, FOCUSCOL);
-	
-	xcb_set_input_focus(conn, XCB_INPUT_FOCUS_POINTER_ROOT, subj->child, XCB_CURRENT_TIME);
-	fwin[curws] = subj;
+static void ungrab_keys() {
+	for (int i = 0; i < screens_len; i++) {
+		xcb_ungrab_key(conn, XCB_GRAB_ANY, screens[i]->root, XCB_MOD_MASK_ANY);
+	}
 }
 
-static void stack_above(window *subj) {
-	uint32_t mask = XCB_CONFIG_WINDOW_STACK_MODE;
-	uint32_t val  = XCB_STACK_MODE_ABOVE;
-	xcb_configure_window(conn, subj->child, mask, &val);
+static void grab_keys() {
+	xcb_key_symbols_free(keysyms);
+
+	keysyms = xcb_key_symbols_alloc(conn);
+
+	core_grab_keys(grab_key);
 }
 
-static void raise(window *subj) {
-	if (subj == stack[curws]) {
-		return;
+static void grab_button(uint16_t mod, uint32_t button) {
+	uint32_t mask = XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE;
+	for (int i = 0; i < screens_len; i++) {
+		xcb_window_t root = screens[i]->root;
+		xcb_grab_button(conn, 0, root, mask, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
+				root, XCB_NONE, button, mod);
 	}
+}
 
-	insert(curws, excise(curws, subj));
-
-	stack_above(subj);
+static void core_grab(xcb_window_t root) {
+	uint32_t mask = XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_BUTTON_MOTION |
+			XCB_EVENT_MASK_POINTER_MOTION_HINT;
+	uint32_t mode = XCB_GRAB_MODE_ASYNC;
+	xcb_grab_pointer(conn, 0, root, mask, mode, mode, root, XCB_NONE, XCB_CURRENT_TIME);
 }
 
-static void center_pointer(window *subj) {
-	xcb_get_geometry_reply_t *temp = w_get_geometry(subj->child);
-	uint32_t x = (temp->width + 2 * BORDER)/2;
-	uint32_t y = (temp->height + 2 * BORDER)/2;
-	xcb_warp_pointer(conn, XCB_NONE, subj->child, 0, 0, 0, 0, x, y);
-	free(temp);
+#ifdef XINPUT
+/* without the device grab no device motion comes, so the drag goes on with core events */
+static void xi_grabbed(void **reply, xcb_window_t root) {
+	xcb_input_xi_grab_device_reply_t *r = reply[0];
+	if (!xi_drag || (r && r->status == XCB_GRAB_STATUS_SUCCESS)) {
+		return;
+	}
+
+	LOG("device grab refused, dragging with core events");
+	xi_drag = 0;
+	core_grab(root);
 }
+#endif
 
-static void kill(xcb_window_t win) {
-	xcb_icccm_get_wm_protocols_reply_t pro;
-	xcb_get_property_cookie_t cookie;
-	cookie = xcb_icccm_get_wm_protocols_unchecked(conn, win, ewmh->WM_PROTOCOLS);
-	if (!xcb_icccm_get_wm_protocols_reply(conn, cookie, &pro, NULL)) {
-		xcb_kill_client(conn, win);
+static void grab_pointer(xcb_window_t root) {
+#ifdef XINPUT
+	//device events carry the exact position, so no query and no motion hint
+	if (xi_opcode) {
+		uint32_t mask = XCB_INPUT_XI_EVENT_MASK_MOTION | XCB_INPUT_XI_EVENT_MASK_BUTTON_RELEASE;
+		uint8_t mode = XCB_INPUT_GRAB_MODE_22_ASYNC;
+		xcb_input_xi_grab_device_cookie_t cookie = xcb_input_xi_grab_device(conn, root,
+				XCB_CURRENT_TIME, XCB_NONE, xi_pointer, mode, mode,
+				XCB_INPUT_GRAB_OWNER_NO_OWNER, 1, &mask);
+		await(expect(xi_grabbed, root), cookie.sequence);
+
+		xi_drag = 1;
+		drag_x = -1;
+		drag_y = -1;
 		return;
 	}
+#endif
 
-	for (int i = 0; i < pro.atoms_len; i++) {
-		if (pro.atoms[i] == wm_atoms[WM_DELETE_WINDOW]) {
-			xcb_icccm_get_wm_protocols_reply_wipe(&pro);
-			goto a;
-		}
+	core_grab(root);
+}
+
+static void ungrab_pointer() {
+#ifdef XINPUT
+	if (xi_drag) {
+		xi_drag = 0;
+		xcb_input_xi_ungrab_device(conn, XCB_CURRENT_TIME, xi_pointer);
+		return;
 	}
-	xcb_icccm_get_wm_protocols_reply_wipe(&pro);
-	xcb_kill_client(conn, win);
-	return;
+#endif
 
-	a:;
-	
+	xcb_ungrab_pointer(conn, XCB_CURRENT_TIME);
+}
+
+static void send_protocol(xcb_window_t win, xcb_atom_t atom) {
 	xcb_client_message_event_t ev;
+	memset(&ev, 0, sizeof(ev));
 	ev.response_type = XCB_CLIENT_MESSAGE;
 	ev.format = 32;
 	ev.sequence = 0;
 	ev.window = win;
 	ev.type = wm_atoms[WM_PROTOCOLS];
-	ev.data.data32[0] = wm_atoms[WM_DELETE_WINDOW];
+	ev.data.data32[0] = atom;
 	ev.data.data32[1] = XCB_CURRENT_TIME;
+	ev.data.data32[2] = win;
 	uint32_t mask = XCB_EVENT_MASK_NO_EVENT;
-	xcb_send_event(conn, 0, win, mask, (char *)&ev);	
+	xcb_send_event(conn, 0, win, mask, (char *)&ev);
+}
+
+static uint64_t now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
 }
 
-static void close(int arg) {
-	if (fwin[curws]) {
-		kill(fwin[curws]->child);
+/* point the timer at the earliest deadline, or disarm it */
+static void arm() {
+	uint64_t first = wake;
+	for (unsigned int i = 0; i < closes_len; i++) {
+		if (!first || closes[i].deadline < first) {
+			first = closes[i].deadline;
+		}
 	}
+
+	struct itimerspec its;
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec = first / 1000;
+	its.it_value.tv_nsec = first % 1000 * 1000000;
+	timerfd_settime(timer, TFD_TIMER_ABSTIME, &its, NULL);
 }
 
-static void cycle_raise(window *cur) {
-	for (; cur != fwin[curws];) {
-		window *temp = cur->prev;
-		raise(cur); 
-		cur = temp;
+static int find_close(xcb_window_t win) {
+	for (unsigned int i = 0; i < closes_len; i++) {
+		if (closes[i].win == win) {
+			return i;
+		}
 	}
+	return -1;
 }
 
-static void stop_cycle() {
-	state = DEFAULT;
-	traverse(stack[curws], normal_events); 
+static void stop_close(xcb_window_t win) {
+	int i = find_close(win);
+	if (i < 0) {
+		return;
+	}
+
+	closes[i] = closes[--closes_len];
+	arm();
 }
 
-static void cycle(int arg) {
-	if (!stack[curws] || !stack[curws]->next) {
+static void close_client(xcb_window_t win, uint32_t protocols) {
+	//asking twice means the user has stopped waiting
+	if (find_close(win) >= 0) {
+		stop_close(win);
+		xcb_kill_client(conn, win);
 		return;
 	}
 
-	if (state != CYCLE) {
-		traverse(stack[curws], release_events);
-		marker = fwin[curws];
-		state = CYCLE;
+	if (!(protocols & PROTO_DELETE)) {
+		xcb_kill_client(conn, win);
+		return;
 	}
 
-	if (marker->next) {
-		cycle_raise(marker);
-		marker = fwin[curws];
-		center_pointer(marker->next);
-		raise(marker->next);
-	} else {
-		cycle_raise(marker);
-		center_pointer(stack[curws]);
-		marker = fwin[curws];
+	send_protocol(win, wm_atoms[WM_DELETE_WINDOW]);
+
+	if (!(protocols & PROTO_PING) || timer < 0) {
+		return;
+	}
+
+	send_protocol(win, ewmh->_NET_WM_PING);
+
+	if (closes_len == closes_cap) {
+		closes_cap = closes_cap ? 2 * closes_cap : 8;
+		closes = realloc(closes, closes_cap * sizeof(closing));
 	}
+	closes[closes_len].win = win;
+	closes[closes_len].deadline = now() + PING_TIMEOUT;
+	closes_len++;
+
+	arm();
 }
 
-static void change_ws(int arg) {
-	if (arg == curws) {
+static void expire() {
+	uint64_t expirations;
+	if (read(timer, &expirations, sizeof(expirations)) < 0) {
 		return;
 	}
-	
-	traverse(stack[arg], map);
-	traverse(stack[curws], ignore_unmap); 
-	
-	if (fwin[arg]) {
-		focus(fwin[arg]);
+
+	wake = 0;
+
+	uint64_t cur = now();
+	for (unsigned int i = 0; i < closes_len;) {
+		if (closes[i].deadline <= cur) {
+			xcb_kill_client(conn, closes[i].win);
+			closes[i] = closes[--closes_len];
+		} else {
+			i++;
+		}
 	}
-	
-	curws = arg;
+
+	arm();
 }
 
-static void send_ws(int arg) {
-	if (!fwin[curws] || arg == curws) {
-		return;
+static uint32_t get_protocols(xcb_get_property_reply_t *reply) {
+	xcb_icccm_get_wm_protocols_reply_t pro;
+	if (!reply || !xcb_icccm_get_wm_protocols_from_reply(reply, &pro)) {
+		return 0;
 	}
 
-	stack_above(fwin[curws]);
-	
-	fwin[curws]->ignore_unmap = 1;
-	insert(arg, excise(curws, fwin[curws]));
-	xcb_unmap_window(conn, fwin[curws]->child);
+	uint32_t ret = 0;
+	for (int i = 0; i < pro.atoms_len; i++) {
+		if (pro.atoms[i] == wm_atoms[WM_DELETE_WINDOW]) {
+			ret |= PROTO_DELETE;
+		} else if (pro.atoms[i] == ewmh->_NET_WM_PING) {
+			ret |= PROTO_PING;
+		}
+	}
+	return ret;
 }
 
-static void save_state(xcb_window_t win, xcb_rectangle_t *state) {
-	xcb_get_geometry_reply_t *temp = w_get_geometry(win);
-	state->x = temp->x;
-	state->y = temp->y;
-	state->width = temp->width;
-	state->height = temp->height;
-	free(temp);
+/* what the backend learns from replies and devices, recorded so that a replay needs none */
+static void learned(trace_reply_t *rec) {
+	if (record) {
+		trace_record_reply(rec);
+	}
+
+	switch (rec->kind) {
+		case TRACE_PROTOCOLS:
+			core_set_protocols(rec->window, rec->protocols);
+			break;
+		case TRACE_STRUT:
+			core_set_strut(rec->window, rec->strut);
+			break;
+		case TRACE_POINTER:
+			core_screen(rec->root);
+			core_motion_notify(rec->ptr_x, rec->ptr_y);
+			break;
+	}
 }
 
-static void snap_save_state(window *win) {
-	save_state(win->child, &win->snap);
-	
-	win->is_snap = 1;
+static void protocols_reply(void **reply, xcb_window_t win) {
+	trace_reply_t rec = { TRACE_REPLY, TRACE_PROTOCOLS };
+	rec.window = win;
+	rec.protocols = get_protocols(reply[0]);
+	learned(&rec);
 }
 
-static void snap_restore_state(window *win) {
-	move_resize(win->child, win->snap.x, win->snap.y, win->snap.width, win->snap.height);
-	
-	win->is_snap = 0;
-}
-
-#define SNAP_TEMPLATE(A, B, C, D, E) static void A(int arg) {                   \
-	if (!fwin[curws] || fwin[curws]->is_e_full || fwin[curws]->is_i_full) { \
-		return;                                                         \
-	}                                                                       \
-	                                                                        \
-	if (!fwin[curws]->is_snap) {                                            \
-		snap_save_state(fwin[curws]);                                   \
-	}                                                                       \
-	                                                                        \
-	move_resize(fwin[curws]->child, B, C, D, E);                            \
-	                                                                        \
-	if (state == MOVE) {                                                    \
-		return;                                                         \
-	}                                                                       \
-	                                                                        \
-	center_pointer(fwin[curws]);                                            \
-	raise(fwin[curws]);                                                     \
-}
-
-#ifndef SNAP_MAX_SMART
-SNAP_TEMPLATE(snap_max,
-	GAP,
-	GAP + TOP,
-	scr->width_in_pixels - 2 * GAP - 2 * BORDER,
-	scr->height_in_pixels - 2 * GAP - 2 * BORDER - TOP - BOT)
-#endif
-#ifdef SNAP_MAX_SMART 
-SNAP_TEMPLATE(snap_max,
-	0,
-	TOP,
-	scr->width_in_pixels - 2 * BORDER,
-	scr->height_in_pixels - 2 * BORDER - TOP - BOT)
-#endif
+static void get_strut(xcb_get_property_reply_t *reply, uint32_t *strut) {
+	xcb_ewmh_wm_strut_partial_t partial;
+	if (!reply || !xcb_ewmh_get_wm_strut_partial_from_reply(&partial, reply)) {
+		memset(strut, 0, 4 * sizeof(uint32_t));
+		return;
+	}
+
+	strut[0] = partial.left;
+	strut[1] = partial.right;
+	strut[2] = partial.top;
+	strut[3] = partial.bottom;
+}
 
-SNAP_TEMPLATE(snap_l,
-	GAP,
-	GAP + TOP,
-	scr->width_in_pixels / 2 - 1.5 * GAP - BORDER * 2,
-	scr->height_in_pixels - 2 * GAP - 2 * BORDER - TOP - BOT)
+static void strut_reply(void **reply, xcb_window_t win) {
+	trace_reply_t rec = { TRACE_REPLY, TRACE_STRUT };
+	rec.window = win;
+	get_strut(reply[0], rec.strut);
+	learned(&rec);
+}
+
+#define CHECK_MASK(A, B, C, D, E) \
+	if (D & E) {              \
+		A[B++] = C;       \
+	}
 
-SNAP_TEMPLATE(snap_lu,
-	GAP,
-	GAP + TOP,
-	scr->width_in_pixels / 2 - 1.5 * GAP - BORDER * 2,
-	(scr->height_in_pixels - TOP - BOT) / 2 - 1.5 * GAP - 2 * BORDER)
+static void configure(const command *cmd) {
+	uint32_t vals[7];
+	int i = 0;
 
-SNAP_TEMPLATE(snap_ld,
-	GAP,
-	(scr->height_in_pixels - TOP - BOT) / 2 + GAP / 2 + TOP,
-	scr->width_in_pixels / 2 - 1.5 * GAP - BORDER * 2,
-	(scr->height_in_pixels - TOP - BOT) / 2 - 1.5 * GAP - 2 * BORDER)
+	CHECK_MASK(vals, i, cmd->x, cmd->mask, XCB_CONFIG_WINDOW_X)
+	CHECK_MASK(vals, i, cmd->y, cmd->mask, XCB_CONFIG_WINDOW_Y)
+	CHECK_MASK(vals, i, cmd->width, cmd->mask, XCB_CONFIG_WINDOW_WIDTH)
+	CHECK_MASK(vals, i, cmd->height, cmd->mask, XCB_CONFIG_WINDOW_HEIGHT)
+	CHECK_MASK(vals, i, cmd->border, cmd->mask, XCB_CONFIG_WINDOW_BORDER_WIDTH)
+	CHECK_MASK(vals, i, cmd->sibling, cmd->mask, XCB_CONFIG_WINDOW_SIBLING)
+	CHECK_MASK(vals, i, cmd->stack_mode, cmd->mask, XCB_CONFIG_WINDOW_STACK_MODE)
 
-SNAP_TEMPLATE(snap_r,
-	scr->width_in_pixels / 2 + GAP / 2,
-	GAP + TOP,
-	scr->width_in_pixels / 2 - 1.5 * GAP - BORDER * 2,
-	scr->height_in_pixels - 2 * GAP - 2 * BORDER - TOP - BOT)
+	ignore_enter(xcb_configure_window(conn, cmd->win, cmd->mask, vals));
+}
 
-SNAP_TEMPLATE(snap_ru,
-	scr->width_in_pixels / 2 + GAP / 2,
-	GAP + TOP,
-	scr->width_in_pixels / 2 - 1.5 * GAP - BORDER * 2,
-	(scr->height_in_pixels - TOP - BOT) / 2 - 1.5 * GAP - 2 * BORDER)
+static void restack(const command *cmd) {
+	uint32_t mask = XCB_CONFIG_WINDOW_STACK_MODE;
+	uint32_t vals[2];
+	int i = 0;
 
-SNAP_TEMPLATE(snap_rd,
-	scr->width_in_pixels / 2 + GAP / 2,
-	(scr->height_in_pixels - TOP - BOT) / 2 + GAP / 2 + TOP,
-	scr->width_in_pixels / 2 - 1.5 * GAP - BORDER * 2,
-	(scr->height_in_pixels - TOP - BOT) / 2 - 1.5 * GAP - 2 * BORDER)
+	if (cmd->sibling) {
+		mask |= XCB_CONFIG_WINDOW_SIBLING;
+		vals[i++] = cmd->sibling;
+	}
+	vals[i] = cmd->stack_mode;
 
-static void full_save_state(window *win) {
-	raise(win);
+	ignore_enter(xcb_configure_window(conn, cmd->win, mask, vals));
+}
 
-	save_state(win->child, &win->full);
+static void select_events(const command *cmd) {
+	uint32_t mask = XCB_CW_EVENT_MASK;
+	uint32_t val = XCB_EVENT_MASK_ENTER_WINDOW | XCB_EVENT_MASK_PROPERTY_CHANGE;
+	xcb_change_window_attributes(conn, cmd->win, mask, &val);
 }
 
-static void full_restore_state(window *win) {
-	move_resize(win->child, win->full.x, win->full.y, win->full.width, win->full.height);
+static void grab_keyboard(xcb_window_t root) {
+	uint8_t mode = XCB_GRAB_MODE_ASYNC;
+	xcb_grab_keyboard_cookie_t cookie;
+	cookie = xcb_grab_keyboard(conn, 0, root, XCB_CURRENT_TIME, mode, mode);
+	xcb_discard_reply(conn, cookie.sequence);
 }
 
-static void full(window *win) {
-	move_resize(win->child, -BORDER, -BORDER, scr->width_in_pixels, scr->height_in_pixels);
+static void color(const command *cmd) {
+	uint32_t mask = XCB_CW_BORDER_PIXEL;
+	xcb_change_window_attributes(conn, cmd->win, mask, &cmd->val);
 }
 
-static void int_full(int arg) {
-	if (!fwin[curws]) {
-		return;
+//every workspace shares the one work area
+static void workarea(const command *cmd) {
+	xcb_ewmh_geometry_t list[cmd->val];
+	for (unsigned int i = 0; i < cmd->val; i++) {
+		list[i].x = cmd->x;
+		list[i].y = cmd->y;
+		list[i].width = cmd->width;
+		list[i].height = cmd->height;
 	}
+	xcb_ewmh_set_workarea(ewmh, screen_of(cmd->win), cmd->val, list);
+}
 
-	fwin[curws]->is_i_full = !fwin[curws]->is_i_full;
-
-	if (fwin[curws]->is_e_full) {
-		return;
+//a replay carries out commands on the stand-ins for the windows they name
+static const command *translate(const command *cmd, command *copy) {
+	if (!replay) {
+		return cmd;
 	}
 
-	if (!fwin[curws]->is_i_full) {
-		full_restore_state(fwin[curws]); 
-		return;
+	*copy = *cmd;
+	copy->win = live(cmd->win);
+	copy->sibling = live(cmd->sibling);
+	return copy;
+}
+
+/* carry out everything the core queued while handling the last event */
+static void run() {
+	unsigned int len;
+	const command *cmds = core_commands(&len);
+
+	for (unsigned int i = 0; i < len; i++) {
+		command copy;
+		const command *cmd = translate(&cmds[i], &copy);
+		switch (cmd->type) {
+			case CMD_CONFIGURE:
+				configure(cmd);
+				break;
+			case CMD_RESTACK:
+				restack(cmd);
+				break;
+			case CMD_MAP:
+				ignore_enter(xcb_map_window(conn, cmd->win));
+				break;
+			case CMD_UNMAP:
+				ignore_enter(xcb_unmap_window(conn, cmd->win));
+				break;
+			case CMD_FOCUS:
+				xcb_set_input_focus(conn, XCB_INPUT_FOCUS_POINTER_ROOT, cmd->win,
+						XCB_CURRENT_TIME);
+				break;
+			case CMD_COLOR:
+				color(cmd);
+				break;
+			case CMD_EVENTS:
+				select_events(cmd);
+				break;
+			case CMD_WARP:
+				ignore_enter(xcb_warp_pointer(conn, XCB_NONE, cmd->win, 0, 0, 0, 0,
+						cmd->x, cmd->y));
+				break;
+			case CMD_CLOSE:
+				//a stand-in has no client to ask
+				if (replay) {
+					xcb_destroy_window(conn, cmd->win);
+				} else {
+					close_client(cmd->win, cmd->val);
+				}
+				break;
+			case CMD_GRAB:
+				grab_pointer(cmd->win);
+				break;
+			case CMD_UNGRAB:
+				ungrab_pointer();
+				break;
+			case CMD_GRAB_KEYBOARD:
+				grab_keyboard(cmd->win);
+				break;
+			case CMD_UNGRAB_KEYBOARD:
+				xcb_ungrab_keyboard(conn, XCB_CURRENT_TIME);
+				break;
+			case CMD_WORKAREA:
+				workarea(cmd);
+				break;
+			case CMD_THROTTLE:
+				if (cmd->val) {
+					printf("araiwm: window 0x%x had %u requests coalesced.\n",
+							cmd->win, cmd->val);
+				} else {
+					printf("araiwm: throttling window 0x%x.\n", cmd->win);
+				}
+				break;
+			case CMD_ADOPT:
+				start_adopt(cmd->win, cmd->win);
+				break;
+		}
 	}
-	
-	full_save_state(fwin[curws]);
 
-	full(fwin[curws]);
+	core_clear();
 }
 
-static void ext_full(window *subj) {
-	subj->is_e_full = !subj->is_e_full;
+/* hand replies up to the given sequence to their continuations, in request order */
+static void complete(unsigned int upto) {
+	for (; conts_head < conts_len;) {
+		continuation *cont = &conts[conts_head];
+		if (cont->seq[cont->len - 1] > upto) {
+			break;
+		}
+
+		for (; cont->got < cont->len; cont->got++) {
+			xcb_generic_error_t *err = NULL;
+			void *reply = NULL;
+
+			if (!xcb_poll_for_reply(conn, cont->seq[cont->got], &reply, &err)) {
+				return;
+			}
 
-	if (!subj->is_e_full) {
-		if (!subj->is_i_full) {
-			full_restore_state(subj);
+			free(err);
+			cont->reply[cont->got] = reply;
 		}
 
-		return;
-	}
-		
-	if (!subj->is_i_full) {
-		full_save_state(subj);
+		//the callback may queue more continuations and move the array
+		continuation done = *cont;
+		conts_head++;
+
+		done.func(done.reply, done.win);
+		for (int i = 0; i < done.len; i++) {
+			free(done.reply[i]);
+		}
+
+		run();
 	}
 
-	full(fwin[curws]);	
+	if (conts_head == conts_len) {
+		conts_head = 0;
+		conts_len = 0;
+	}
 }
 
-static uint32_t size_helper(uint32_t win_sze, uint32_t scr_sze) {
-	return win_sze > scr_sze ? scr_sze : win_sze;
+static int get_type(xcb_get_property_reply_t *reply) {
+	xcb_ewmh_get_atoms_reply_t type;
+	if (!reply || !xcb_ewmh_get_wm_window_type_from_reply(&type, reply)) {
+		return TYPE_NORMAL;
+	}
+
+	//types come in order of preference, the first one we know wins
+	for (unsigned int i = 0; i < type.atoms_len; i++) {
+		xcb_atom_t atom = type.atoms[i];
+		if (atom == ewmh->_NET_WM_WINDOW_TYPE_DOCK 
+				|| atom == ewmh->_NET_WM_WINDOW_TYPE_TOOLBAR) {
+			return TYPE_DOCK;
+		} else if (atom == ewmh->_NET_WM_WINDOW_TYPE_DESKTOP) {
+			return TYPE_DESKTOP;
+		} else if (atom == ewmh->_NET_WM_WINDOW_TYPE_DIALOG) {
+			return TYPE_DIALOG;
+		} else if (atom == ewmh->_NET_WM_WINDOW_TYPE_UTILITY) {
+			return TYPE_UTILITY;
+		} else if (atom == ewmh->_NET_WM_WINDOW_TYPE_SPLASH) {
+			return TYPE_SPLASH;
+		} else if (atom == ewmh->_NET_WM_WINDOW_TYPE_NORMAL) {
+			return TYPE_NORMAL;
+		}
+	}
+	return TYPE_NORMAL;
 }
 
-static uint32_t place_helper(uint32_t ptr_pos, uint32_t win_sze, uint32_t scr_sze) {
-	if (ptr_pos < win_sze / 2 + BORDER) {
-		return 0;
-	} else if (ptr_pos + win_sze / 2 + BORDER > scr_sze) {
-		return scr_sze - win_sze - 2 * BORDER;
-	} else {
-		return ptr_pos - win_sze / 2 - BORDER;
+static const char *get_class(xcb_get_property_reply_t *reply) {
+	xcb_icccm_get_wm_class_reply_t class;
+	if (!reply || !xcb_icccm_get_wm_class_from_reply(&class, reply)) {
+		return NULL;
 	}
+	return class.class_name;
 }
 
-static void map_request(xcb_generic_event_t *ev) {
-	xcb_map_request_event_t *e = (xcb_map_request_event_t *)ev;
-	if (all_wtf(e->window, NULL)) {
-		return;
+static const char *get_role(xcb_get_property_reply_t *reply, char *buf, unsigned int size) {
+	if (!reply || reply->type != XCB_ATOM_STRING || reply->format != 8) {
+		return NULL;
 	}
-	
-	xcb_get_property_cookie_t cookie = xcb_ewmh_get_wm_window_type(ewmh, e->window);
-	xcb_ewmh_get_atoms_reply_t type;
-	if (xcb_ewmh_get_wm_window_type_reply(ewmh, cookie, &type, NULL)) {
-		for (unsigned int i = 0; i < type.atoms_len; i++) {		
-			if (type.atoms[i] == ewmh->_NET_WM_WINDOW_TYPE_DOCK 
-					|| type.atoms[i] == ewmh->_NET_WM_WINDOW_TYPE_TOOLBAR
-					|| type.atoms[i] == ewmh->_NET_WM_WINDOW_TYPE_DESKTOP) {
-				xcb_ewmh_get_atoms_reply_wipe(&type);
-				xcb_map_window(conn, e->window);
-				return;
-			}
-		}
-		xcb_ewmh_get_atoms_reply_wipe(&type);
+
+	unsigned int len = xcb_get_property_value_length(reply);
+	if (len >= size) {
+		len = size - 1;
 	}
 
-	window *win = malloc(sizeof(window));
-	win->child = e->window;
-	win->ignore_unmap = 0;
-	win->is_snap = 0;
-	win->is_e_full = 0;
-	win->is_i_full = 0;
+	memcpy(buf, xcb_get_property_value(reply), len);
+	buf[len] = '\0';
+	return buf;
+}
+
+//a replay matches rules on as much of the class and role as fits
+static void record_names(const char *class, const char *role) {
+	trace_names_t rec = { TRACE_REPLY, TRACE_NAMES };
+	int size = sizeof(rec.names);
 
-	xcb_get_geometry_reply_t *init_geom = w_get_geometry(win->child);
+	int len = snprintf(rec.names, size - 1, "%s", class ? class : "");
+	if (len > size - 2) {
+		len = size - 2;
+	}
+	snprintf(rec.names + len + 1, size - len - 1, "%s", role ? role : "");
 
-	if (init_geom->height > scr->height_in_pixels) {
+	trace_record_reply(&rec);
+}
 
+/* what adoption learned, from the server or from a trace */
+static void adopted(trace_reply_t *rec, const char *class, const char *role) {
+	if (record) {
+		record_names(class, role);
+		trace_record_reply(rec);
 	}
 
-	xcb_query_pointer_reply_t *ptr = w_query_pointer();
-	uint32_t w = size_helper(init_geom->width, scr->width_in_pixels);
-	uint32_t h = size_helper(init_geom->height, scr->height_in_pixels);
-	uint32_t x = place_helper(ptr->root_x, w, scr->width_in_pixels);
-	uint32_t y = place_helper(ptr->root_y, h, scr->height_in_pixels);
-	move_resize(win->child, x, y, w, h);
-	free(ptr);
-	free(init_geom);
+	properties props;
+	props.type = rec->type;
+	props.protocols = rec->protocols;
+	memcpy(props.strut, rec->strut, sizeof(props.strut));
+	props.class = class;
+	props.role = role;
 
-	uint32_t mask = XCB_CONFIG_WINDOW_BORDER_WIDTH;
-	uint32_t val = BORDER;
-	xcb_configure_window(conn, win->child, mask, &val);
+	xcb_rectangle_t geom = { rec->x, rec->y, rec->width, rec->height };
+	core_screen(rec->root);
+	core_map_request(rec->window, &props, &geom, rec->ptr_x, rec->ptr_y);
+}
 
-	color(win->child, UNFOCUSCOL);
+static void adopt(void **reply, xcb_window_t win) {
+	xcb_get_geometry_reply_t *g = reply[1];
+	xcb_query_pointer_reply_t *p = reply[2];
 
-	normal_events(win);
-	
-	xcb_map_window(conn, e->window);
-	
-	insert(curws, win);
-	if (!state) {
-		focus(win);
+	if (!g || !p) {
+		return;
+	}
+
+	char role[ROLE_LEN * 4 + 1];
+
+	trace_reply_t rec = { TRACE_REPLY, TRACE_ADOPT };
+	rec.type = get_type(reply[0]);
+	rec.protocols = get_protocols(reply[3]);
+	rec.window = win;
+	rec.root = g->root;
+	rec.x = g->x;
+	rec.y = g->y;
+	rec.width = g->width;
+	rec.height = g->height;
+	get_strut(reply[4], rec.strut);
+
+	//the pointer is elsewhere, so place the window where it asked to be
+	if (!p->same_screen || p->root != g->root) {
+		rec.ptr_x = g->x + g->width / 2;
+		rec.ptr_y = g->y + g->height / 2;
+	} else {
+		rec.ptr_x = p->root_x;
+		rec.ptr_y = p->root_y;
 	}
+
+	adopted(&rec, get_class(reply[5]), get_role(reply[6], role, sizeof(role)));
 }
 
-static void enter_notify(xcb_generic_event_t *ev) {
-	xcb_enter_notify_event_t *e = (xcb_enter_notify_event_t *)ev;
-	window *found = ws_wtf(e->event, curws);
-	if (found) {
-		focus(found);
+/* replayed windows do not exist here, so each gets a blank one where it was */
+static void stand_in(trace_reply_t *rec) {
+	if (find_alias(rec->window) >= 0) {
+		return;
 	}
+
+	xcb_screen_t *on = screens[screen_of(live(rec->root))];
+	xcb_window_t win = xcb_generate_id(conn);
+	uint32_t val = on->white_pixel;
+	xcb_create_window(conn, XCB_COPY_FROM_PARENT, win, on->root, rec->x, rec->y,
+			rec->width ? rec->width : 1, rec->height ? rec->height : 1, 0,
+			XCB_WINDOW_CLASS_INPUT_OUTPUT, on->root_visual, XCB_CW_BACK_PIXEL, &val);
+	add_alias(rec->window, win);
 }
 
-static int move_resize_helper(xcb_window_t win, xcb_get_geometry_reply_t **geom) {
-	window *found = ws_wtf(win, curws);
-	if (!found || found != fwin[curws]) {
-		return 0;
+/* a replay acts on recorded replies as if they had just come in */
+static void replay_reply(xcb_generic_event_t *ev) {
+	trace_reply_t *rec = (trace_reply_t *)ev;
+
+	if (rec->kind == TRACE_NAMES) {
+		memcpy(&names, ev, sizeof(names));
+		names.names[sizeof(names.names) - 1] = '\0';
+		return;
 	}
 
-	raise(fwin[curws]);
-	
-	if (fwin[curws]->is_e_full || fwin[curws]->is_i_full) {
-		return 0;
+	if (rec->kind != TRACE_ADOPT) {
+		learned(rec);
+		return;
 	}
 
-	*geom = w_get_geometry(fwin[curws]->child);
+	stand_in(rec);
 
-	return 1;
+	const char *class = names.names;
+	const char *role = class + strlen(class) + 1;
+	adopted(rec, *class ? class : NULL, *role ? role : NULL);
+	memset(&names, 0, sizeof(names));
+
+	replay_adopted++;
+	replay_managed += core_is_managed(rec->window);
 }
 
-static void grab_pointer() {
-	uint32_t mask = XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_BUTTON_MOTION |
-			XCB_EVENT_MASK_POINTER_MOTION_HINT;
-	uint32_t mode = XCB_GRAB_MODE_ASYNC;
-	xcb_grab_pointer(conn, 0, scr->root, mask, mode, mode, scr->root, XCB_NONE,
-			XCB_CURRENT_TIME);
+static int adopting(xcb_window_t win) {
+	for (unsigned int i = conts_head; i < conts_len; i++) {
+		if (conts[i].func == adopt && conts[i].win == win) {
+			return 1;
+		}
+	}
+	return 0;
 }
 
-static void mouse_move(xcb_window_t win, uint32_t event_x, uint32_t event_y) {
-	xcb_get_geometry_reply_t *geom;
-	
-	if (!move_resize_helper(win, &geom)) {
+/* read everything adopt needs in one wave, the pointer is queried on any window of its root */
+static void start_adopt(xcb_window_t win, xcb_window_t parent) {
+	//watch for changes before reading, so none fall in between
+	uint32_t val = XCB_EVENT_MASK_PROPERTY_CHANGE;
+	xcb_change_window_attributes(conn, win, XCB_CW_EVENT_MASK, &val);
+
+	continuation *cont = expect(adopt, win);
+	await(cont, xcb_ewmh_get_wm_window_type(ewmh, win).sequence);
+	await(cont, xcb_get_geometry(conn, win).sequence);
+	await(cont, xcb_query_pointer(conn, parent).sequence);
+	await(cont, xcb_icccm_get_wm_protocols(conn, win, ewmh->WM_PROTOCOLS).sequence);
+	await(cont, xcb_ewmh_get_wm_strut_partial(ewmh, win).sequence);
+	await(cont, xcb_icccm_get_wm_class(conn, win).sequence);
+	await(cont, xcb_get_property(conn, 0, win, wm_atoms[WM_WINDOW_ROLE],
+			XCB_ATOM_STRING, 0, ROLE_LEN).sequence);
+}
+
+static void map_request(xcb_generic_event_t *ev) {
+	xcb_map_request_event_t *e = (xcb_map_request_event_t *)ev;
+
+	//the trace holds what adoption learned
+	if (replay) {
+		replay_maps++;
 		return;
 	}
 
-	if (fwin[curws]->is_snap) {
-		x = fwin[curws]->snap.width * (event_x - geom->x) / geom->width;
-		y = fwin[curws]->snap.height * (event_y - geom->y) / geom->height; 
-	} else {
-		x = event_x - geom->x;
-		y = event_y - geom->y;
+	//a window mapping over and over waits its turn like any other request
+	if (core_is_managed(e->window) || adopting(e->window) || !core_admit(e->window)) {
+		return;
 	}
-	
-	free(geom);
-	
-	state = MOVE;
 
-	grab_pointer();
+	start_adopt(e->window, e->parent);
 }
 
-static void mouse_resize(xcb_window_t win, uint32_t event_x, uint32_t event_y) {
-	xcb_get_geometry_reply_t *geom;
-
-	if (!move_resize_helper(win, &geom)) {
+static void property_notify(xcb_generic_event_t *ev) {
+	xcb_property_notify_event_t *e = (xcb_property_notify_event_t *)ev;
+	if (replay || !core_is_managed(e->window)) {
 		return;
 	}
 
-	fwin[curws]->is_snap = 0;
-	x = geom->width - event_x;
-	y = geom->height - event_y;
+	trace_reply_t rec = { TRACE_REPLY };
+	rec.window = e->window;
 
-	state = RESIZE;
-	
-	free(geom);
-	
-	grab_pointer();
-}
+	int gone = e->state == XCB_PROPERTY_DELETE;
+	xcb_get_property_cookie_t cookie;
 
-static void button_press(xcb_generic_event_t *ev) {
-	xcb_button_press_event_t *e = (xcb_button_press_event_t *)ev;
+	if (e->atom == ewmh->WM_PROTOCOLS) {
+		if (gone) {
+			rec.kind = TRACE_PROTOCOLS;
+			learned(&rec);
+			return;
+		}
 
-	for (int i = 0; i < LEN(buttons); i++) {
-		if (e->detail == buttons[i].button && buttons[i].mod == e->state) {
-			buttons[i].function(e->child, e->event_x, e->event_y);
-			break;
+		cookie = xcb_icccm_get_wm_protocols(conn, e->window, ewmh->WM_PROTOCOLS);
+		await(expect(protocols_reply, e->window), cookie.sequence);
+	} else if (e->atom == ewmh->_NET_WM_STRUT_PARTIAL) {
+		if (gone) {
+			rec.kind = TRACE_STRUT;
+			learned(&rec);
+			return;
 		}
+
+		cookie = xcb_ewmh_get_wm_strut_partial(ewmh, e->window);
+		await(expect(strut_reply, e->window), cookie.sequence);
 	}
 }
 
-static void mouse_snap(uint32_t ptr_pos, uint32_t tolerance, void (*snap_x)(int arg),
-		void (*snap_y)(int arg), void (*snap_z)(int arg)) {
-	if (ptr_pos < SNAP_CORNER) {
-		snap_x(0);
-	} else if (ptr_pos > tolerance - SNAP_CORNER) {
-		snap_y(0);
-	} else {
-		snap_z(0);
-	}
+static void enter_notify(xcb_generic_event_t *ev) {
+	xcb_enter_notify_event_t *e = (xcb_enter_notify_event_t *)ev;
+	core_screen(e->root);
+	core_enter_notify(e->event);
 }
 
-static void motion_notify(xcb_generic_event_t *ev) {
-	xcb_motion_notify_event_t *e = (xcb_motion_notify_event_t *)ev;
+static void button_press(xcb_generic_event_t *ev) {
+	xcb_button_press_event_t *e = (xcb_button_press_event_t *)ev;
+	core_screen(e->root);
+	core_button_press(e->child, e->detail, e->state, e->event_x, e->event_y);
+}
 
-	xcb_query_pointer_reply_t *p = w_query_pointer();
+static void pointer_reply(void **reply, xcb_window_t win) {
+	xcb_query_pointer_reply_t *p = reply[0];
 	if (!p) {
 		return;
 	}
-	
-	if (state == MOVE) {
-		if (p->root_x < SNAP_MARGIN) {
-			mouse_snap(p->root_y, scr->height_in_pixels, snap_lu, snap_ld, snap_l);
-		} else if (p->root_y < SNAP_MARGIN) {
-			mouse_snap(p->root_x, scr->width_in_pixels, snap_lu, snap_ru, snap_max);
-		} else if (p->root_x > scr->width_in_pixels - SNAP_MARGIN) {
-			mouse_snap(p->root_y, scr->height_in_pixels, snap_ru, snap_rd, snap_r);
-		} else if (p->root_y > scr->height_in_pixels - SNAP_MARGIN) {
-			mouse_snap(p->root_x, scr->width_in_pixels, snap_ld, snap_rd, snap_max);
-		} else {
-			if (fwin[curws]->is_snap) {
-				snap_restore_state(fwin[curws]);
-			}
 
-			move(fwin[curws]->child, p->root_x - x, p->root_y - y);
-		}
-	} else if (state == RESIZE) {
-		resize(fwin[curws]->child, p->root_x + x, p->root_y + y);
+	trace_reply_t rec = { TRACE_REPLY, TRACE_POINTER };
+	rec.root = p->root;
+	rec.ptr_x = p->root_x;
+	rec.ptr_y = p->root_y;
+	learned(&rec);
+}
+
+static void motion_notify(xcb_generic_event_t *ev) {
+	xcb_motion_notify_event_t *e = (xcb_motion_notify_event_t *)ev;
+	if (replay) {
+		return;
 	}
 
-	free(p);
+	await(expect(pointer_reply, XCB_NONE), xcb_query_pointer(conn, e->root).sequence);
 }
 
 static void button_release(xcb_generic_event_t *ev) {
-	xcb_ungrab_pointer(conn, XCB_CURRENT_TIME);
-	state = DEFAULT;
+	core_button_release();
 }
 
-static void key_press(xcb_generic_event_t *ev) {
-	xcb_key_press_event_t *e = (xcb_key_press_event_t *)ev;
-	xcb_keysym_t keysym = xcb_key_symbols_get_keysym(keysyms, e->detail, 0);
+#ifdef XINPUT
+static int16_t round_fp1616(xcb_input_fp1616_t val) {
+	return (val + 0x8000) >> 16;
+}
 
-	if (keysym != XK_Tab && state == CYCLE) {
-		stop_cycle();
+/* sub-pixel motion piles up in the server until it crosses a whole pixel */
+static void generic_event(xcb_generic_event_t *ev) {
+	xcb_ge_generic_event_t *ge = (xcb_ge_generic_event_t *)ev;
+	if (!xi_opcode || ge->extension != xi_opcode) {
+		return;
 	}
 
-	for (int i = 0; i < LEN(keys); i++) {
-		if (keysym == keys[i].key && keys[i].mod == e->state) {
-			keys[i].function(keys[i].arg);
-			break;
-		}
+	xcb_input_motion_event_t *e = (xcb_input_motion_event_t *)ev;
+	if (e->deviceid != xi_pointer) {
+		return;
 	}
-}
-
-static void key_release(xcb_generic_event_t *ev) {
-	xcb_key_release_event_t *e = (xcb_key_release_event_t *)ev;
-	xcb_keysym_t keysym = xcb_key_symbols_get_keysym(keysyms, e->detail, 0);
 
-	if (keysym == XK_Super_L && state == CYCLE) {
-		stop_cycle();
+	if (ge->event_type == XCB_INPUT_BUTTON_RELEASE) {
+		core_button_release();
+		return;
 	}
-}
 
-static void forget_client(window *subj, int ws) {
-	if ((state == MOVE || state == RESIZE) && subj == fwin[curws]) {
-		button_release(NULL);
+	int16_t x = round_fp1616(e->root_x);
+	int16_t y = round_fp1616(e->root_y);
+	if (ge->event_type != XCB_INPUT_MOTION || (x == drag_x && y == drag_y)) {
+		return;
 	}
 
-	free(excise(ws, subj));
-	
-	if (ws != curws || fwin[curws] != subj) {
+	drag_x = x;
+	drag_y = y;
+
+	trace_reply_t rec = { TRACE_REPLY, TRACE_POINTER };
+	rec.root = e->root;
+	rec.ptr_x = x;
+	rec.ptr_y = y;
+	learned(&rec);
+}
+
+static void xi_init() {
+	const xcb_query_extension_reply_t *ext = xcb_get_extension_data(conn, &xcb_input_id);
+	if (!ext || !ext->present) {
 		return;
 	}
 
-	if (!stack[curws]) {
-		fwin[curws] = NULL;
-	} else {
-		focus(stack[curws]);
+	xcb_input_xi_query_version_cookie_t version = xcb_input_xi_query_version(conn, 2, 0);
+	xcb_input_xi_get_client_pointer_cookie_t pointer;
+	pointer = xcb_input_xi_get_client_pointer(conn, XCB_NONE);
+
+	xcb_input_xi_query_version_reply_t *ver;
+	ver = xcb_input_xi_query_version_reply(conn, version, NULL);
+	xcb_input_xi_get_client_pointer_reply_t *ptr;
+	ptr = xcb_input_xi_get_client_pointer_reply(conn, pointer, NULL);
+
+	if (ver && ver->major_version >= 2 && ptr) {
+		xi_opcode = ext->major_opcode;
+		xi_pointer = ptr->deviceid;
 	}
+
+	free(ver);
+	free(ptr);
+}
+#endif
+
+static void key_press(xcb_generic_event_t *ev) {
+	xcb_key_press_event_t *e = (xcb_key_press_event_t *)ev;
+	core_screen(e->root);
+	core_key_press(xcb_key_symbols_get_keysym(keysyms, e->detail, 0), e->state);
+}
+
+static void key_release(xcb_generic_event_t *ev) {
+	xcb_key_release_event_t *e = (xcb_key_release_event_t *)ev;
+	core_screen(e->root);
+	core_key_release(xcb_key_symbols_get_keysym(keysyms, e->detail, 0));
 }
 
 static void unmap_notify(xcb_generic_event_t *ev) {
 	xcb_unmap_notify_event_t *e = (xcb_unmap_notify_event_t *)ev;
+	core_unmap_notify(e->window);
 
-	window *found = ws_wtf(e->window, curws);
-	if (!found) {
+	//our own unmaps keep the window managed, and a pending kill with it
+	if (core_is_managed(e->window)) {
 		return;
 	}
 
-	if (found->ignore_unmap) {
-		found->ignore_unmap = 0;
-	} else {
-		forget_client(found, curws);
+	stop_close(e->window);
+
+	//the recorded client took its window down, not us
+	if (replay) {
+		xcb_unmap_window(conn, live(e->window));
 	}
 }
 
 static void destroy_notify(xcb_generic_event_t *ev) {
 	xcb_destroy_notify_event_t *e = (xcb_destroy_notify_event_t *)ev;
+	stop_close(e->window);
+	core_destroy_notify(e->window);
 
-	int ws;
-	window *found = all_wtf(e->window, &ws);
-	if (found) {
-		forget_client(found, ws);
+	xcb_window_t win = replay ? drop_alias(e->window) : XCB_NONE;
+	if (win) {
+		xcb_destroy_window(conn, win);
 	}
 }
 
 static void client_message(xcb_generic_event_t *ev) {
 	xcb_client_message_event_t *e = (xcb_client_message_event_t *)ev;
+	if (e->type == ewmh->WM_PROTOCOLS && e->data.data32[0] == ewmh->_NET_WM_PING) {
+		stop_close(e->data.data32[2]);
+		return;
+	}
 
-	window *found = all_wtf(e->window, NULL);
+	if (e->type == ewmh->_NET_RESTACK_WINDOW) {
+		core_restack(e->window, e->data.data32[1], e->data.data32[2]);
+		return;
+	}
 
-	if (!found || e->type != ewmh->_NET_WM_STATE) {
+	if (e->type != ewmh->_NET_WM_STATE) {
 		return;
 	}	
 
 	for (int i = 1; i < 3; i++) {
 		xcb_atom_t atom = (xcb_atom_t)e->data.data32[i];
 		if (atom == ewmh->_NET_WM_STATE_FULLSCREEN) {
-			switch (2 * e->data.data32[0] + found->is_e_full) {
-				case 2 * XCB_EWMH_WM_STATE_ADD:
-					ext_full(found);
-					break;
-				case 2 * XCB_EWMH_WM_STATE_REMOVE + 1:
-					ext_full(found);
-					break;
-				case 2 * XCB_EWMH_WM_STATE_TOGGLE:
-					/* FALLTHROUGH */
-				case 2 * XCB_EWMH_WM_STATE_TOGGLE + 1:
-					ext_full(found);
-			}
+			core_fullscreen(e->window, e->data.data32[0]);
+		} else if (atom == ewmh->_NET_WM_STATE_ABOVE) {
+			core_layer(e->window, LAYER_ABOVE, e->data.data32[0]);
+		} else if (atom == ewmh->_NET_WM_STATE_BELOW) {
+			core_layer(e->window, LAYER_BELOW, e->data.data32[0]);
 		}
 	}
 }
@@ -792,72 +1084,190 @@ static void mapping_notify(xcb_generic_event_t *ev) {
 		return;
 	}
 
-	xcb_ungrab_key(conn, XCB_GRAB_ANY, scr->root, XCB_MOD_MASK_ANY);
+	ungrab_keys();
 	grab_keys();
 }
 
-#define CHECK_MASK(A, B, C, D, E) \
-	if (D & E) {              \
-		A[B++] = C;       \
+static void configure_request(xcb_generic_event_t *ev) {
+	xcb_configure_request_event_t *e = (xcb_configure_request_event_t *)ev;
+
+	command req;
+	req.mask = e->value_mask;
+	req.x = e->x;
+	req.y = e->y;
+	req.width = e->width;
+	req.height = e->height;
+	req.border = e->border_width;
+	req.sibling = e->sibling;
+	req.stack_mode = e->stack_mode;
+
+	core_configure_request(e->window, &req);
+}
+
+static void flush() {
+	//later crossings caused by the user must not share our sequence
+	if (enter_fence) {
+		xcb_no_operation(conn);
+		enter_fence = 0;
 	}
 
-static int mask_to_geo(xcb_configure_request_event_t *e, uint32_t *vals) {
-	int i = 0;
+	xcb_flush(conn);
+}
 
-	CHECK_MASK(vals, i, e->x, e->value_mask, XCB_CONFIG_WINDOW_X)
-	CHECK_MASK(vals, i, e->y, e->value_mask, XCB_CONFIG_WINDOW_X)
-	CHECK_MASK(vals, i, e->width, e->value_mask, XCB_CONFIG_WINDOW_WIDTH)
-	CHECK_MASK(vals, i, e->height, e->value_mask, XCB_CONFIG_WINDOW_X)
+/* release deferred requests of throttled windows and keep the timer on the next refill */
+static void tick() {
+	uint64_t next = core_tick(now());
+	run();
 
-	return i;
+	if (next != wake) {
+		wake = next;
+		arm();
+	}
 }
 
-static void configure_request(xcb_generic_event_t *ev) {
-	xcb_configure_request_event_t *e = (xcb_configure_request_event_t *)ev;
-	window *found = all_wtf(e->window, NULL);
-	
-	uint32_t vals[6];
+static xcb_generic_event_t *next_event() {
+	struct pollfd fds[2] = {
+		{ xcb_get_file_descriptor(conn), POLLIN, 0 },
+		{ timer, POLLIN, 0 },
+	};
 
-	if (!found) {
-		int i = mask_to_geo(e, vals);
+	for (;;) {
+		xcb_generic_event_t *ev = xcb_poll_for_event(conn);
+		if (ev || xcb_connection_has_error(conn)) {
+			return ev;
+		}
+
+		complete(UINT32_MAX);
+
+		ev = xcb_poll_for_queued_event(conn);
+		if (ev) {
+			return ev;
+		}
+
+		flush();
+		poll(fds, 2, -1);
 
-		CHECK_MASK(vals, i, e->sibling, e->value_mask, XCB_CONFIG_WINDOW_SIBLING)
-		CHECK_MASK(vals, i, e->stack_mode, e->value_mask, XCB_CONFIG_WINDOW_STACK_MODE)
+		if (quit) {
+			return NULL;
+		}
 
-		xcb_configure_window(conn, e->window, e->value_mask, vals);
-	} else if (!found->is_i_full && !found->is_e_full) {
-		mask_to_geo(e, vals);
-		uint32_t ignore = XCB_CONFIG_WINDOW_STACK_MODE | XCB_CONFIG_WINDOW_SIBLING;
-		xcb_configure_window(conn, found->child, e->value_mask & ~ignore, vals);
+		if (fds[1].revents & POLLIN) {
+			expire();
+			tick();
+		}
 	}
 }
 
-static void cleanup(window *win) {
-	kill(win->child);
-	free(win);
+/* enter events caused by our own requests carry their sequence */
+static int ours(xcb_generic_event_t *ev) {
+	return !replay && (ev->response_type & ~0x80) == XCB_ENTER_NOTIFY
+			&& ev->full_sequence <= enter_seq;
 }
 
-static void die() {
-	for (int i = 0; i < NUM_WS; i++) {
-		traverse(stack[i], cleanup);
+static void dispatch(xcb_generic_event_t *ev) {
+	if (!replay) {
+		complete(ev->full_sequence);
+	}
+
+	//a trace only holds what was acted on, in the order it was
+	uint8_t type = ev->response_type & ~0x80;
+	if (!events[type] || ours(ev)) {
+		return;
+	}
+
+	if (record) {
+		trace_record(ev);
+	}
+
+	events[type](ev);
+	run();
+
+	//the rest of the batch may take a while, get input handled now
+	if (prio_is_input(ev)) {
+		flush();
 	}
+}
 
-	xcb_ungrab_key(conn, XCB_GRAB_ANY, scr->root, XCB_MOD_MASK_ANY);
+static void stop(int sig) {
+	quit = sig;
+}
+
+/* every close is answered from the cache, so shutdown is a single flush */
+static void die() {
+	close(timer);
+	timer = -1;
+
+	//a hangup only ever means restart
+	core_die(!close_windows || quit == SIGHUP);
+	run();
+	xcb_flush(conn);
+
+	ungrab_keys();
 	xcb_key_symbols_free(keysyms);
 	xcb_disconnect(conn);
+
+	trace_close();
 }
 
-int main(void) {
+int main(int argc, char **argv) {
+	int fast = 0;
+	int bad = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+			record = argv[++i];
+		} else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+			replay = argv[++i];
+		} else if (!strcmp(argv[i], "-f")) {
+			fast = 1;
+		} else if (!strcmp(argv[i], "-c")) {
+			close_windows = 1;
+		} else {
+			bad = 1;
+		}
+	}
+
+	//a replay cannot record, its windows only stand in for the recorded ones
+	if (bad || (record && replay)) {
+		LOG("usage: araiwm [-c] [-t trace | -r trace [-f]]");
+		return 1;
+	}
+
+	if (record && !trace_record_open(record)) {
+		LOG("could not open trace for recording");
+		return 1;
+	}
+
+	if (replay && !trace_replay_open(replay)) {
+		LOG("could not open trace for replay");
+		return 1;
+	}
+
 	conn = xcb_connect(NULL, NULL);
-	scr = xcb_setup_roots_iterator(xcb_get_setup(conn)).data;
 
 	uint32_t mask = XCB_CW_EVENT_MASK;
 	uint32_t val = XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY | XCB_EVENT_MASK_SUBSTRUCTURE_REDIRECT;
 
-	xcb_change_window_attributes(conn, scr->root, mask, &val);
+	xcb_screen_iterator_t iter = xcb_setup_roots_iterator(xcb_get_setup(conn));
+	screens = malloc(iter.rem * sizeof(xcb_screen_t *));
+	for (; iter.rem; xcb_screen_next(&iter)) {
+		screens[screens_len++] = iter.data;
+
+		//a replay leaves the windows of this server to their clients
+		if (!replay) {
+			xcb_change_window_attributes(conn, iter.data->root, mask, &val);
+		}
+	}
 	
 	atexit(die);
 
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop;
+	sigaction(SIGTERM, &sa, NULL);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGHUP, &sa, NULL);
+
 	ewmh = calloc(1, sizeof(xcb_ewmh_connection_t));
 	if (!ewmh) {
 		LOG("could not allocate ewmh connection");
@@ -865,31 +1275,65 @@ int main(void) {
 	}
 	xcb_ewmh_init_atoms_replies(ewmh, xcb_ewmh_init_atoms(conn, ewmh), (void *)0);
 
-	const char *WM_ATOM_NAME[2]; 
+	timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer < 0) {
+		LOG("could not create close timer");
+		return 0;
+	}
+
+	const char *WM_ATOM_NAME[WM_COUNT]; 
 	WM_ATOM_NAME[0] = "WM_PROTOCOLS";
 	WM_ATOM_NAME[1] = "WM_DELETE_WINDOW";
+	WM_ATOM_NAME[2] = "WM_WINDOW_ROLE";
 	get_atoms(WM_ATOM_NAME, wm_atoms, WM_COUNT);
 	
-	const char *NET_ATOM_NAME[3];
+	const char *NET_ATOM_NAME[NET_COUNT];
 	NET_ATOM_NAME[0] = "_NET_SUPPORTED";
 	NET_ATOM_NAME[1] = "_NET_WM_STATE_FULLSCREEN";
 	NET_ATOM_NAME[2] = "_NET_WM_STATE";
+	NET_ATOM_NAME[3] = "_NET_WM_PING";
+	NET_ATOM_NAME[4] = "_NET_WM_STATE_ABOVE";
+	NET_ATOM_NAME[5] = "_NET_WM_STATE_BELOW";
+	NET_ATOM_NAME[6] = "_NET_RESTACK_WINDOW";
+	NET_ATOM_NAME[7] = "_NET_WORKAREA";
+	NET_ATOM_NAME[8] = "_NET_WM_STRUT_PARTIAL";
 	get_atoms(NET_ATOM_NAME, net_atoms, NET_COUNT);
-	xcb_change_property(conn, XCB_PROP_MODE_REPLACE, scr->root, net_atoms[NET_SUPPORTED],
-			XCB_ATOM_ATOM, 32, NET_COUNT, net_atoms);
 
-	mask = XCB_EVENT_MASK_BUTTON_PRESS | XCB_EVENT_MASK_BUTTON_RELEASE;
-	for (int i = 0; i < LEN(buttons); i++) {
-		xcb_grab_button(conn, 0, scr->root, mask, XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC,
-				scr->root, XCB_NONE, buttons[i].button, buttons[i].mod);
+	core_init();
+
+	for (int i = 0; i < screens_len; i++) {
+		xcb_screen_t *scr = screens[i];
+		xcb_change_property(conn, XCB_PROP_MODE_REPLACE, scr->root,
+				net_atoms[NET_SUPPORTED], XCB_ATOM_ATOM, 32, NET_COUNT, net_atoms);
+
+		if (replay) {
+			continue;
+		}
+
+		if (record) {
+			trace_add_screen(scr->root, scr->width_in_pixels, scr->height_in_pixels);
+		}
+		core_add_screen(scr->root, scr->width_in_pixels, scr->height_in_pixels);
 	}
 
-	grab_keys();
-	
-	void (*events[XCB_NO_OPERATION])(xcb_generic_event_t *event);
+	//a replay runs on the recorded screens, ours only stand in for them
+	unsigned int replay_len = 0;
+	const trace_screen_t *replay_screens = replay ? trace_screens(&replay_len) : NULL;
+	for (unsigned int i = 0; i < replay_len; i++) {
+		add_alias(replay_screens[i].root, screens[i < screens_len ? i : 0]->root);
+		core_add_screen(replay_screens[i].root, replay_screens[i].width,
+				replay_screens[i].height);
+	}
+	run();
 
-	for (int i = 0; i < XCB_NO_OPERATION; i++) events[i] = NULL;
+	core_grab_buttons(grab_button);
 
+#ifdef XINPUT
+	xi_init();
+#endif
+
+	grab_keys();
+	
 	events[XCB_BUTTON_PRESS]      = button_press;
 	events[XCB_BUTTON_RELEASE]    = button_release;
 	events[XCB_MOTION_NOTIFY]     = motion_notify;
@@ -902,17 +1346,50 @@ int main(void) {
 	events[XCB_DESTROY_NOTIFY]    = destroy_notify;
 	events[XCB_ENTER_NOTIFY]      = enter_notify;
 	events[XCB_MAPPING_NOTIFY]    = mapping_notify;
+	events[XCB_PROPERTY_NOTIFY]   = property_notify;
+#ifdef XINPUT
+	events[XCB_GE_GENERIC]        = generic_event;
+#endif
+	if (replay) {
+		events[TRACE_REPLY]   = replay_reply;
+	}
 
-	keysyms = xcb_key_symbols_alloc(conn);
+	xcb_generic_event_t *batch[PRIO_BATCH];
+	for (; !quit && !xcb_connection_has_error(conn);) {
+		flush();
+
+		if (replay) {
+			//the live connection only echoes what the trace holds
+			xcb_generic_event_t *ev;
+			for (; (ev = xcb_poll_for_event(conn)); free(ev));
+			complete(UINT32_MAX);
+			batch[0] = trace_replay(fast);
+		} else {
+			batch[0] = next_event();
+		}
 
-	xcb_generic_event_t *ev;
-	for (; !xcb_connection_has_error(conn);) {
-		xcb_flush(conn);
-		ev = xcb_wait_for_event(conn);
-		if (events[ev->response_type & ~0x80]) {
-			events[ev->response_type & ~0x80](ev);
+		if (!batch[0]) {
+			break;
 		}
-		free(ev);
+
+		//take whatever else has arrived, so input in it can go first
+		unsigned int len = 1;
+		for (; !replay && len < PRIO_BATCH && (batch[len] = xcb_poll_for_event(conn)); len++);
+
+		tick();
+		prio_dispatch(batch, len, core_focused, core_is_managed, dispatch);
+		tick();
+
+		for (unsigned int i = 0; i < len; i++) {
+			free(batch[i]);
+		}
+	}
+
+	//a replay that manages none of the windows it mapped reproduced nothing
+	if (replay) {
+		printf("araiwm: replay mapped %u windows, adopted %u and managed %u.\n",
+				replay_maps, replay_adopted, replay_managed);
+		return replay_maps && !replay_managed;
 	}
 
 	return 0;
@@ -15,6 +15,17 @@ typedef struct {
 	void (*function) (xcb_window_t win, uint32_t event_x, uint32_t event_y);
 } button;
 
+typedef struct {
+	const char *class;
+	const char *role;
+	int type;
+
+	int ws;
+	void (*snap) (int arg);
+	int full;
+	int unmanaged;
+} rule;
+
 static void close(int arg);
 static void cycle(int arg);
 
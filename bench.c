@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <time.h>
+
+#include <X11/keysym.h>
+
+#include "core.h"
+#include "prio.h"
+
+/* drives the default bindings from config.h without an X server */
+
+#define MOD XCB_MOD_MASK_4
+#define SHIFT XCB_MOD_MASK_SHIFT
+
+#define ROOT 0x100
+#define WINDOWS 32
+#define ROUNDS 20000
+#define STORMS 20000
+
+static unsigned long events = 0;
+static unsigned long cmds = 0;
+
+static double input_at = 0;
+
+static int out_of_order = 0;
+static int lost_focus = 0;
+static int lost_window = 0;
+static int unthrottled = 0;
+
+static xcb_generic_event_t *seen[PRIO_BATCH];
+static unsigned int seen_len = 0;
+
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void drain() {
+	unsigned int len;
+	core_commands(&len);
+	cmds += len;
+	core_clear();
+	events++;
+}
+
+/* WINDOWS ordinary windows on the current workspace, from base up */
+static void populate(xcb_window_t base) {
+	xcb_rectangle_t geom = { 0, 0, 640, 480 };
+	properties props = { TYPE_NORMAL, PROTO_DELETE };
+
+	for (int i = 0; i < WINDOWS; i++) {
+		core_map_request(base + i, &props, &geom, 20 * i, 10 * i);
+		drain();
+	}
+}
+
+static void round_trip(xcb_window_t base) {
+	populate(base);
+
+	for (int i = 0; i < WINDOWS; i++) {
+		core_enter_notify(base + i);
+		drain();
+	}
+
+	for (int i = 0; i < 8; i++) {
+		core_key_press(XK_Tab, MOD);
+		drain();
+	}
+	core_key_release(XK_Super_L);
+	drain();
+
+	core_key_press(XK_Left, MOD);
+	drain();
+	core_key_press(XK_Right, MOD);
+	drain();
+	core_key_press(XK_f, MOD | SHIFT);
+	drain();
+	core_key_press(XK_f, MOD | SHIFT);
+	drain();
+
+	core_button_press(base + WINDOWS - 1, XCB_BUTTON_INDEX_1, MOD, 100, 100);
+	drain();
+	for (int i = 0; i < 64; i++) {
+		core_motion_notify(100 + 10 * i, 100 + 5 * i);
+		drain();
+	}
+	core_button_release();
+	drain();
+
+	core_key_press(XK_2, MOD | SHIFT);
+	drain();
+	core_key_press(XK_2, MOD);
+	drain();
+	core_key_press(XK_1, MOD);
+	drain();
+
+	command req = { .mask = XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+			.width = 300, .height = 200 };
+	for (int i = 0; i < WINDOWS; i++) {
+		core_configure_request(base + i, &req);
+		drain();
+	}
+
+	for (int i = 0; i < WINDOWS; i++) {
+		core_destroy_notify(base + i);
+		drain();
+	}
+}
+
+/* a window mapping and unmapping itself runs dry like one flooding configure requests, and
+ * is adopted once it has saved up again */
+static void remap(xcb_window_t win) {
+	xcb_rectangle_t geom = { 0, 0, 640, 480 };
+	properties props = { TYPE_NORMAL, PROTO_DELETE };
+
+	core_tick(0);
+
+	int maps = 0;
+	for (; maps < 1000 && core_admit(win); maps++) {
+		core_map_request(win, &props, &geom, 0, 0);
+		core_unmap_notify(win);
+	}
+	core_clear();
+
+	core_tick(1000);
+
+	unsigned int len;
+	const command *cmds = core_commands(&len);
+	int adopted = 0;
+	for (unsigned int i = 0; i < len; i++) {
+		adopted |= cmds[i].type == CMD_ADOPT && cmds[i].win == win;
+	}
+	core_clear();
+
+	int kept = maps < 1000 && adopted;
+	printf("remapping %s after %d maps\n", kept ? "throttled" : "NOT THROTTLED", maps);
+	unthrottled |= !kept;
+
+	core_map_request(win, &props, &geom, 0, 0);
+	core_destroy_notify(win);
+	core_clear();
+}
+
+static void order_dispatch(xcb_generic_event_t *ev) {
+	seen[seen_len++] = ev;
+}
+
+/* a key pressed after the pointer entered a window must act on that window, and a key
+ * pressed after a window died must not cycle through it */
+static void order(void) {
+	xcb_configure_request_event_t req = { .response_type = XCB_CONFIGURE_REQUEST,
+			.window = ROOT + 1 };
+	xcb_enter_notify_event_t enter = { .response_type = XCB_ENTER_NOTIFY, .event = ROOT + 2 };
+	xcb_key_press_event_t key = { .response_type = XCB_KEY_PRESS };
+	xcb_generic_event_t *batch[] = {
+		(xcb_generic_event_t *)&req,
+		(xcb_generic_event_t *)&enter,
+		(xcb_generic_event_t *)&key,
+	};
+
+	seen_len = 0;
+	prio_dispatch(batch, 3, core_focused, core_is_managed, order_dispatch);
+
+	int kept = seen[0] == batch[1] && seen[1] == batch[2];
+	printf("crossing before key %s\n", kept ? "kept" : "REORDERED");
+	out_of_order |= !kept;
+
+	xcb_rectangle_t geom = { 0, 0, 640, 480 };
+	properties props = { TYPE_NORMAL, PROTO_DELETE };
+	core_map_request(ROOT + 3, &props, &geom, 0, 0);
+	core_map_request(ROOT + 4, &props, &geom, 0, 0);
+	core_clear();
+
+	xcb_destroy_notify_event_t destroy = { .response_type = XCB_DESTROY_NOTIFY,
+			.window = ROOT + 3 };
+	batch[0] = (xcb_generic_event_t *)&destroy;
+	batch[1] = (xcb_generic_event_t *)&key;
+
+	seen_len = 0;
+	prio_dispatch(batch, 2, core_focused, core_is_managed, order_dispatch);
+
+	kept = seen[0] == batch[0] && seen[1] == batch[1];
+	printf("destroy before key %s\n", kept ? "kept" : "REORDERED");
+	out_of_order |= !kept;
+
+	core_destroy_notify(ROOT + 3);
+	core_destroy_notify(ROOT + 4);
+	core_clear();
+}
+
+/* a workspace whose focused window died behind its back still has something to focus */
+static void hidden_focus(xcb_window_t base) {
+	xcb_rectangle_t geom = { 0, 0, 640, 480 };
+	properties props = { TYPE_NORMAL, PROTO_DELETE };
+
+	core_key_press(XK_2, MOD);
+	for (int i = 0; i < 3; i++) {
+		core_map_request(base + i, &props, &geom, 0, 0);
+	}
+	core_key_press(XK_1, MOD);
+	core_destroy_notify(base + 2);
+	core_key_press(XK_2, MOD);
+	core_key_press(XK_Tab, MOD);
+	core_key_release(XK_Super_L);
+
+	int kept = core_focused() != XCB_NONE;
+	printf("hidden focus %s\n", kept ? "kept" : "LOST");
+	lost_focus |= !kept;
+
+	core_key_press(XK_1, MOD);
+	core_destroy_notify(base);
+	core_destroy_notify(base + 1);
+	core_clear();
+}
+
+/* going fullscreen on a hidden workspace leaves the visible one alone */
+static void hidden_full(xcb_window_t base) {
+	xcb_rectangle_t geom = { 0, 0, 640, 480 };
+	properties props = { TYPE_NORMAL, PROTO_DELETE };
+
+	core_map_request(base, &props, &geom, 0, 0);
+	core_map_request(base + 1, &props, &geom, 0, 0);
+	core_key_press(XK_2, MOD | SHIFT);
+	core_fullscreen(base + 1, STATE_ADD);
+
+	int kept = core_is_managed(base) && core_focused() == base;
+	core_destroy_notify(base);
+	core_destroy_notify(base + 1);
+	kept &= !core_is_managed(base) && !core_is_managed(base + 1);
+	core_clear();
+
+	printf("hidden fullscreen %s\n", kept ? "kept" : "LOST A WINDOW");
+	lost_window |= !kept;
+}
+
+static void storm_dispatch(xcb_generic_event_t *ev) {
+	if (ev->response_type == XCB_KEY_PRESS) {
+		core_key_press(XK_Left, MOD);
+		input_at = now();
+	} else if (ev->response_type == XCB_CONFIGURE_REQUEST) {
+		xcb_configure_request_event_t *e = (xcb_configure_request_event_t *)ev;
+		command req = { .mask = e->value_mask, .width = e->width, .height = e->height };
+		core_configure_request(e->window, &req);
+	}
+	drain();
+}
+
+/* a client floods configure requests while the user presses a key */
+static double storm(xcb_window_t base, int prioritise) {
+	xcb_configure_request_event_t reqs[PRIO_BATCH - 1];
+	xcb_key_press_event_t key = { .response_type = XCB_KEY_PRESS };
+	xcb_generic_event_t *batch[PRIO_BATCH];
+
+	populate(base);
+
+	for (int i = 0; i < PRIO_BATCH - 1; i++) {
+		reqs[i] = (xcb_configure_request_event_t){ .response_type = XCB_CONFIGURE_REQUEST };
+		reqs[i].window = base + i % (WINDOWS - 1);
+		reqs[i].value_mask = XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT;
+		reqs[i].width = 100 + i;
+		reqs[i].height = 100 + i;
+		batch[i] = (xcb_generic_event_t *)&reqs[i];
+	}
+	batch[PRIO_BATCH - 1] = (xcb_generic_event_t *)&key;
+
+	double start = now();
+	if (prioritise) {
+		prio_dispatch(batch, PRIO_BATCH, core_focused, core_is_managed, storm_dispatch);
+	} else {
+		for (int i = 0; i < PRIO_BATCH; i++) {
+			storm_dispatch(batch[i]);
+		}
+	}
+	double latency = input_at - start;
+
+	for (int i = 0; i < WINDOWS; i++) {
+		core_destroy_notify(base + i);
+		drain();
+	}
+
+	return latency;
+}
+
+int main(void) {
+	core_init();
+	core_add_screen(ROOT, 1920, 1080);
+	core_screen(ROOT);
+	core_clear();
+
+	order();
+	hidden_focus(0x180000);
+	hidden_full(0x190000);
+	remap(0x1a0000);
+
+	double start = now();
+	for (int i = 0; i < ROUNDS; i++) {
+		round_trip(0x200000 + i * WINDOWS);
+	}
+	double secs = now() - start;
+
+	printf("%lu events, %lu commands in %.3fs\n", events, cmds, secs);
+	printf("%.0f events/s, %.1f ns/event\n", events / secs, secs * 1e9 / events);
+
+	double ordered = 0;
+	double prioritised = 0;
+	for (int i = 0; i < STORMS; i++) {
+		ordered += storm(0x400000, 0);
+		prioritised += storm(0x400000, 1);
+	}
+
+	printf("input behind %d structural events: %.2f us in order, %.2f us prioritised\n",
+			PRIO_BATCH - 1, ordered * 1e6 / STORMS, prioritised * 1e6 / STORMS);
+
+	return out_of_order || lost_focus || lost_window || unthrottled;
+}
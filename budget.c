@@ -0,0 +1,500 @@
+#include <pthread.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <X11/keysym.h>
+#include <xcb/xcb.h>
+
+/*
+ * runs the real backend against a fake server that answers every request, and counts what
+ * single actions put on the wire. a round trip is a wave of requests that only goes out once
+ * the replies to the wave before it came in.
+ */
+
+#define MOD XCB_MOD_MASK_4
+#define SHIFT XCB_MOD_MASK_SHIFT
+
+#define ROOT 0x100
+#define OTHER_ROOT 0x200
+#define WINDOWS 32
+
+//a dock whose protocols are asked for after each action, its query marks the end of a wave
+#define SENTINEL 0x10000
+#define BASE 0x20000
+
+#define MIN_KEYCODE 8
+#define ATOMS 64
+
+int araiwm_main(int argc, char **argv);
+
+static int fd = -1;
+static uint32_t seq = 0;
+
+static uint8_t in[1 << 18];
+static unsigned int in_len = 0;
+static unsigned int in_pos = 0;
+
+static uint8_t req[1 << 18];
+
+static char *atoms[ATOMS];
+static unsigned int atoms_len = 0;
+
+//the window araiwm last focused, drags only pick that one up
+static xcb_window_t focus = XCB_NONE;
+
+static xcb_window_t ptr_root = ROOT;
+static int16_t ptr_x = 0;
+static int16_t ptr_y = 0;
+
+static int over_budget = 0;
+
+//what the config binds and the actions press, keycodes follow the order
+static const xcb_keysym_t keys[] = {
+	XK_Tab, XK_Left, XK_Right, XK_Up, XK_Down, XK_f, XK_q, XK_1, XK_2, XK_3, XK_4, XK_5,
+	XK_Super_L, XK_Shift_L,
+};
+
+//core requests that are answered, by opcode
+static const uint8_t replies[] = {
+	3, 14, 15, 16, 17, 20, 21, 23, 26, 31, 38, 39, 40, 43, 44, 47, 48, 49, 52, 73, 83, 84,
+	85, 86, 87, 91, 92, 97, 98, 99, 101, 103, 106, 108, 110, 116, 117, 118, 119,
+};
+
+static void put(const void *buf, unsigned int len) {
+	for (const uint8_t *p = buf; len;) {
+		ssize_t n = write(fd, p, len);
+		if (n <= 0) {
+			exit(2);
+		}
+		p += n;
+		len -= n;
+	}
+}
+
+static void take(void *buf, unsigned int len) {
+	for (uint8_t *p = buf; len;) {
+		if (in_pos == in_len) {
+			ssize_t n = read(fd, in, sizeof(in));
+			if (n <= 0) {
+				printf("budget: araiwm went away.\n");
+				exit(2);
+			}
+			in_len = n;
+			in_pos = 0;
+		}
+
+		unsigned int n = in_len - in_pos < len ? in_len - in_pos : len;
+		memcpy(p, in + in_pos, n);
+		in_pos += n;
+		p += n;
+		len -= n;
+	}
+}
+
+static uint32_t word(unsigned int at) {
+	uint32_t ret;
+	memcpy(&ret, req + at, sizeof(ret));
+	return ret;
+}
+
+static uint16_t half(unsigned int at) {
+	uint16_t ret;
+	memcpy(&ret, req + at, sizeof(ret));
+	return ret;
+}
+
+static xcb_atom_t atom(const char *name, unsigned int len) {
+	for (unsigned int i = 0; i < atoms_len; i++) {
+		if (strlen(atoms[i]) == len && !memcmp(atoms[i], name, len)) {
+			return 0x100 + i;
+		}
+	}
+
+	if (atoms_len == ATOMS) {
+		return XCB_NONE;
+	}
+	atoms[atoms_len] = strndup(name, len);
+	return 0x100 + atoms_len++;
+}
+
+#define ATOM(A) atom(A, strlen(A))
+
+static int has_reply(uint8_t opcode) {
+	for (unsigned int i = 0; i < sizeof(replies); i++) {
+		if (replies[i] == opcode) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/* an empty reply to the request just read, with room for the caller to fill in */
+static uint8_t *reply(uint8_t *buf, unsigned int extra) {
+	memset(buf, 0, 32 + extra);
+	buf[0] = 1;
+	uint16_t s = seq;
+	memcpy(buf + 2, &s, 2);
+	uint32_t len = (extra + 3) / 4;
+	memcpy(buf + 4, &len, 4);
+	return buf;
+}
+
+/* xcb leaves the padding of events out of its structs, the wire has all 32 bytes */
+static void send_event(const void *ev, unsigned int size) {
+	uint8_t buf[32] = { 0 };
+	memcpy(buf, ev, size);
+
+	uint16_t s = seq;
+	memcpy(buf + 2, &s, 2);
+	put(buf, sizeof(buf));
+}
+
+static void get_property(uint8_t *buf) {
+	xcb_window_t win = word(4);
+	xcb_atom_t prop = word(8);
+
+	uint32_t val[2];
+	unsigned int len = 0;
+	if (win == SENTINEL && prop == ATOM("_NET_WM_WINDOW_TYPE")) {
+		val[len++] = ATOM("_NET_WM_WINDOW_TYPE_DOCK");
+	} else if (win != SENTINEL && prop == ATOM("WM_PROTOCOLS")) {
+		val[len++] = ATOM("WM_DELETE_WINDOW");
+		val[len++] = ATOM("_NET_WM_PING");
+	}
+
+	reply(buf, 4 * len);
+	if (len) {
+		buf[1] = 32;
+		uint32_t type = XCB_ATOM_ATOM;
+		memcpy(buf + 8, &type, 4);
+		memcpy(buf + 16, &len, 4);
+		memcpy(buf + 32, val, 4 * len);
+	}
+	put(buf, 32 + 4 * len);
+}
+
+static void answer(uint8_t opcode) {
+	uint8_t buf[32 + 4 * 256];
+	uint16_t vals[4];
+
+	switch (opcode) {
+		case XCB_INTERN_ATOM: {
+			xcb_atom_t a = atom((const char *)req + 8, half(4));
+			memcpy(reply(buf, 0) + 8, &a, 4);
+			break;
+		}
+		case XCB_GET_PROPERTY:
+			get_property(buf);
+			return;
+		case XCB_GET_GEOMETRY: {
+			xcb_window_t root = ROOT;
+			reply(buf, 0)[1] = 24;
+			memcpy(buf + 8, &root, 4);
+			vals[0] = 0;
+			vals[1] = 0;
+			vals[2] = 640;
+			vals[3] = 480;
+			memcpy(buf + 12, vals, sizeof(vals));
+			break;
+		}
+		case XCB_QUERY_POINTER:
+			reply(buf, 0)[1] = 1;
+			memcpy(buf + 8, &ptr_root, 4);
+			memcpy(buf + 16, &ptr_x, 2);
+			memcpy(buf + 18, &ptr_y, 2);
+			break;
+		case XCB_GET_KEYBOARD_MAPPING: {
+			uint8_t first = req[4];
+			uint8_t count = req[5];
+			reply(buf, 4 * count)[1] = 1;
+			for (unsigned int i = 0; i < count; i++) {
+				unsigned int k = first + i - MIN_KEYCODE;
+				xcb_keysym_t sym = k < sizeof(keys) / sizeof(*keys) ? keys[k] : XCB_NO_SYMBOL;
+				memcpy(buf + 32 + 4 * i, &sym, 4);
+			}
+			put(buf, 32 + 4 * count);
+			return;
+		}
+		default:
+			//grabs succeed, extensions are missing, everything else is empty
+			reply(buf, 0);
+			break;
+	}
+	put(buf, 32);
+}
+
+/* read one request and answer it if it has a reply, returns its opcode */
+static uint8_t request() {
+	take(req, 4);
+	unsigned int len = half(2) * 4;
+	unsigned int head = 4;
+
+	//big requests carry their length after the header
+	if (!len) {
+		take(req + 4, 4);
+		len = word(4) * 4;
+		head = 8;
+	}
+
+	take(req + head, len - head);
+	seq++;
+
+	uint8_t opcode = req[0];
+	if (opcode == XCB_SET_INPUT_FOCUS) {
+		focus = word(4);
+	}
+
+	if (has_reply(opcode)) {
+		answer(opcode);
+	}
+	return opcode;
+}
+
+static int is_sentinel(uint8_t opcode) {
+	return opcode == XCB_GET_PROPERTY && word(4) == SENTINEL && word(8) == ATOM("WM_PROTOCOLS");
+}
+
+/* nudge the sentinel and read up to its query, counting what came before */
+static unsigned int wave(unsigned int *requests, unsigned int *asked) {
+	xcb_property_notify_event_t ev = { .response_type = XCB_PROPERTY_NOTIFY,
+			.window = SENTINEL, .atom = ATOM("WM_PROTOCOLS") };
+	send_event(&ev, sizeof(ev));
+
+	unsigned int acted = 0;
+	*asked = 0;
+	for (;;) {
+		uint8_t opcode = request();
+		if (is_sentinel(opcode)) {
+			return acted;
+		}
+
+		(*requests)++;
+		*asked += has_reply(opcode);
+
+		//the crossing fence of a batch can trail the sentinel into the next wave
+		acted += opcode != XCB_NO_OPERATION;
+	}
+}
+
+/* waves go on while the last one asked for something, the fence of the last can trail it */
+static void measure(unsigned int *requests, unsigned int *trips) {
+	unsigned int asked = 1;
+	*requests = 0;
+	*trips = 0;
+
+	for (int first = 1; asked; first = 0) {
+		unsigned int acted = wave(requests, &asked);
+		if (!first && acted) {
+			(*trips)++;
+		}
+	}
+	wave(requests, &asked);
+}
+
+static void check(const char *action, unsigned int budget, unsigned int trip_budget) {
+	unsigned int requests;
+	unsigned int trips;
+	measure(&requests, &trips);
+
+	int over = requests > budget || trips > trip_budget;
+	printf("%-12s %3u requests, budget %3u, %u round trips, budget %u%s\n", action,
+			requests, budget, trips, trip_budget, over ? " EXCEEDED" : "");
+	over_budget |= over;
+}
+
+static void settle() {
+	unsigned int requests;
+	unsigned int trips;
+	measure(&requests, &trips);
+}
+
+static void map_request(xcb_window_t win) {
+	xcb_map_request_event_t ev = { .response_type = XCB_MAP_REQUEST, .parent = ROOT,
+			.window = win };
+	send_event(&ev, sizeof(ev));
+}
+
+static void destroy_notify(xcb_window_t win) {
+	xcb_destroy_notify_event_t ev = { .response_type = XCB_DESTROY_NOTIFY, .event = ROOT,
+			.window = win };
+	send_event(&ev, sizeof(ev));
+}
+
+static xcb_keycode_t keycode(xcb_keysym_t sym) {
+	for (unsigned int i = 0; i < sizeof(keys) / sizeof(*keys); i++) {
+		if (keys[i] == sym) {
+			return MIN_KEYCODE + i;
+		}
+	}
+	return 0;
+}
+
+static void key(uint8_t type, xcb_keysym_t sym, uint16_t mod) {
+	xcb_key_press_event_t ev = { .response_type = type, .root = ROOT, .event = ROOT,
+			.detail = keycode(sym), .state = mod };
+	send_event(&ev, sizeof(ev));
+}
+
+static void button(uint8_t type, xcb_window_t win, int16_t x, int16_t y) {
+	xcb_button_press_event_t ev = { .response_type = type, .root = ROOT, .event = ROOT,
+			.child = win, .detail = XCB_BUTTON_INDEX_1, .state = MOD, .root_x = x,
+			.root_y = y, .event_x = x, .event_y = y };
+	send_event(&ev, sizeof(ev));
+}
+
+/* motion is only a hint, the position is what the pointer query answers */
+static void motion(xcb_window_t root, int16_t x, int16_t y) {
+	ptr_root = root;
+	ptr_x = x;
+	ptr_y = y;
+
+	xcb_motion_notify_event_t ev = { .response_type = XCB_MOTION_NOTIFY, .root = root,
+			.event = root, .detail = XCB_MOTION_HINT, .root_x = x, .root_y = y };
+	send_event(&ev, sizeof(ev));
+}
+
+static void put_screen(xcb_window_t root, uint16_t width, uint16_t height) {
+	xcb_screen_t scr = { .root = root, .width_in_pixels = width, .height_in_pixels = height,
+			.root_visual = 0x21, .root_depth = 24, .white_pixel = 0xffffff };
+	put(&scr, sizeof(scr));
+}
+
+static void handshake() {
+	uint8_t hello[12];
+	take(hello, 12);
+
+	uint16_t name_len;
+	uint16_t data_len;
+	memcpy(&name_len, hello + 6, 2);
+	memcpy(&data_len, hello + 8, 2);
+	take(req, (name_len + 3) / 4 * 4 + (data_len + 3) / 4 * 4);
+
+	const char vendor[4] = "fake";
+	xcb_setup_t setup = { .status = 1, .protocol_major_version = 11,
+			.resource_id_base = 0x400000, .resource_id_mask = 0x1fffff,
+			.vendor_len = sizeof(vendor), .maximum_request_length = 0xffff, .roots_len = 2,
+			.min_keycode = MIN_KEYCODE, .max_keycode = 255 };
+	setup.length = (sizeof(setup) - 8 + sizeof(vendor) + 2 * sizeof(xcb_screen_t)) / 4;
+
+	put(&setup, sizeof(setup));
+	put(vendor, sizeof(vendor));
+	put_screen(ROOT, 1920, 1080);
+	put_screen(OTHER_ROOT, 1280, 1024);
+}
+
+static void *wm(void *arg) {
+	char *argv[] = { "araiwm", NULL };
+	araiwm_main(1, argv);
+	return NULL;
+}
+
+/* an abstract socket, so no file is left behind */
+static int listen_display() {
+	int display = 100 + getpid() % 30000;
+
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int len = snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1, "/tmp/.X11-unix/X%d",
+			display);
+
+	int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	socklen_t size = offsetof(struct sockaddr_un, sun_path) + 1 + len;
+	if (sock < 0 || bind(sock, (struct sockaddr *)&addr, size) || listen(sock, 1)) {
+		return -1;
+	}
+
+	char name[16];
+	snprintf(name, sizeof(name), ":%d", display);
+	setenv("DISPLAY", name, 1);
+	return sock;
+}
+
+int main(void) {
+	signal(SIGPIPE, SIG_IGN);
+
+	int sock = listen_display();
+	if (sock < 0) {
+		printf("budget: could not listen for araiwm.\n");
+		return 2;
+	}
+
+	pthread_t thread;
+	pthread_create(&thread, NULL, wm, NULL);
+
+	fd = accept(sock, NULL, NULL);
+	close(sock);
+	handshake();
+
+	//startup ends once the sentinel dock is mapped
+	map_request(SENTINEL);
+	for (uint8_t opcode = 0; opcode != XCB_MAP_WINDOW || word(4) != SENTINEL;) {
+		opcode = request();
+	}
+	settle();
+
+	for (int i = 0; i < WINDOWS - 1; i++) {
+		map_request(BASE + i);
+		settle();
+	}
+
+	map_request(BASE + WINDOWS - 1);
+	check("map_request", 17, 1);
+
+	key(XCB_KEY_PRESS, XK_Tab, MOD);
+	check("cycle", 7, 0);
+	key(XCB_KEY_PRESS, XK_Tab, MOD);
+	check("cycle step", 7, 0);
+	key(XCB_KEY_RELEASE, XK_Super_L, MOD);
+	check("cycle end", 1, 0);
+
+	key(XCB_KEY_PRESS, XK_Left, MOD);
+	check("snap_l", 3, 0);
+	key(XCB_KEY_PRESS, XK_Right, MOD);
+	check("snap_r", 3, 0);
+	key(XCB_KEY_PRESS, XK_f, MOD);
+	check("snap_max", 3, 0);
+
+	key(XCB_KEY_PRESS, XK_f, MOD | SHIFT);
+	check("int_full", 3, 0);
+	key(XCB_KEY_PRESS, XK_f, MOD | SHIFT);
+	check("int_full off", 3, 0);
+
+	xcb_window_t top = focus;
+	button(XCB_BUTTON_PRESS, top, 300, 300);
+	check("drag start", 3, 0);
+	motion(ROOT, 400, 350);
+	check("drag step", 3, 1);
+	motion(OTHER_ROOT, 10, 10);
+	check("drag away", 1, 0);
+	motion(ROOT, 0, 0);
+	check("drag snap", 3, 1);
+	motion(ROOT, 500, 500);
+	check("drag unsnap", 3, 1);
+	button(XCB_BUTTON_RELEASE, top, 500, 500);
+	check("drag end", 1, 0);
+
+	key(XCB_KEY_PRESS, XK_2, MOD | SHIFT);
+	check("send_ws", 6, 0);
+	key(XCB_KEY_PRESS, XK_2, MOD);
+	check("change_ws", WINDOWS + 2, 0);
+	key(XCB_KEY_PRESS, XK_q, MOD);
+	check("close", 2, 0);
+	key(XCB_KEY_PRESS, XK_1, MOD);
+	settle();
+
+	for (int i = 0; i < WINDOWS; i++) {
+		destroy_notify(BASE + i);
+		settle();
+	}
+
+	close(fd);
+	pthread_join(thread, NULL);
+
+	return over_budget;
+}
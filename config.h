@@ -4,8 +4,6 @@
 
 #define NUM_WS 4
 
-#define TOP 34
-#define BOT 0
 #define GAP 10
 #define BORDER 0
 
@@ -18,6 +16,10 @@
 //ignore gaps when maxed
 #define SNAP_MAX_SMART
 
+//configure, fullscreen and map requests a window may make per second, and may save up
+#define RATE 100
+#define BURST 50
+
 /* keyboard modifiers */
 
 #define MOD XCB_MOD_MASK_4
@@ -30,6 +32,18 @@ static const button buttons[] = {
 	{ MOD, XCB_BUTTON_INDEX_3, mouse_resize },
 };
 
+/* window rules, the first match wins. NULL and TYPE_ANY match anything, ws -1 is the current one.
+ * the last, empty entry only ends the table, keep it */
+
+static const rule rules[] = {
+	/* class       role       type         ws  snap      full unmanaged */
+	//{ "Gimp",      NULL,      TYPE_ANY,     1, NULL,     0,   0 },
+	//{ "mpv",       NULL,      TYPE_ANY,    -1, NULL,     1,   0 },
+	//{ "firefox",   "browser", TYPE_NORMAL, -1, snap_max, 0,   0 },
+	//{ NULL,        NULL,      TYPE_SPLASH, -1, NULL,     0,   1 },
+	{ NULL },
+};
+
 /* keyboard controls */
 
 static const keybind keys[] = {
@@ -0,0 +1,1443 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <X11/keysym.h>
+
+#include "core.h"
+#include "config.h"
+
+#define LEN(A) sizeof(A)/sizeof(*A)
+
+//docks and desktops belong to every workspace
+#define STICKY NUM_WS
+
+//windows their clients unmapped, whose token buckets are kept should they map again
+#define DEPARTED 64
+
+#define GEOM_MASK (XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y | XCB_CONFIG_WINDOW_WIDTH | \
+		XCB_CONFIG_WINDOW_HEIGHT)
+#define STACK_MASK (XCB_CONFIG_WINDOW_SIBLING | XCB_CONFIG_WINDOW_STACK_MODE)
+
+enum { DEFAULT, MOVE, RESIZE, CYCLE, };
+
+/* what a window may still ask for, refilled at RATE up to BURST */
+typedef struct {
+	double tokens;
+	uint64_t stamp;
+} bucket;
+
+typedef struct window {
+	struct window *next;
+	struct window *prev;
+
+	//neighbours in the stacking order of the screen, across workspaces
+	struct window *up;
+	struct window *down;
+	int layer;
+
+	xcb_window_t child;
+
+	xcb_rectangle_t geom;
+
+	uint32_t protocols;
+
+	xcb_rectangle_t snap;
+	int is_snap;
+
+	xcb_rectangle_t full;
+	int is_i_full;
+	int is_e_full;
+
+	int ignore_unmap;
+
+	//left, right, top, bottom
+	uint32_t strut[4];
+
+	bucket rate;
+	unsigned int deferred;
+	command pending;
+	int pending_full;
+} window;
+
+/* every root has its own workspaces, stacking order and focus */
+typedef struct {
+	xcb_window_t root;
+	uint16_t width;
+	uint16_t height;
+
+	//the screen less what docks reserve, only recomputed when a strut changes
+	xcb_rectangle_t area;
+
+	window *stack[NUM_WS + 1];
+	window *fwin[NUM_WS + 1];
+
+	window *top;
+
+	int curws;
+} screen;
+
+static screen *screens = NULL;
+static unsigned int screens_len = 0;
+
+//the screen the event being handled happened on
+static screen *scr = NULL;
+
+//the screen holding the input focus
+static screen *focus_scr = NULL;
+
+static unsigned int state = DEFAULT;
+
+static window *marker = NULL;
+
+//what is being moved or resized, and where, the pointer may wander off to another screen
+static window *drag = NULL;
+static screen *drag_scr = NULL;
+
+static uint32_t x = 0;
+static uint32_t y = 0;
+
+static uint64_t clock_ms = 0;
+static unsigned int throttled = 0;
+
+/* a window that went away, mapping it again must not hand it a full bucket */
+typedef struct {
+	xcb_window_t win;
+	bucket rate;
+
+	//its map request waits for a token before the backend adopts it
+	int waiting;
+} departed;
+
+static departed gone[DEPARTED];
+static unsigned int gone_next = 0;
+
+static command *cmds = NULL;
+static unsigned int cmds_len = 0;
+static unsigned int cmds_cap = 0;
+
+static command *emit(uint8_t type, xcb_window_t win) {
+	if (cmds_len == cmds_cap) {
+		cmds_cap = cmds_cap ? 2 * cmds_cap : 64;
+		cmds = realloc(cmds, cmds_cap * sizeof(command));
+	}
+
+	command *cmd = &cmds[cmds_len++];
+	memset(cmd, 0, sizeof(command));
+	cmd->type = type;
+	cmd->win = win;
+	return cmd;
+}
+
+const command *core_commands(unsigned int *len) {
+	*len = cmds_len;
+	return cmds;
+}
+
+void core_clear(void) {
+	cmds_len = 0;
+}
+
+static void insert(int ws, window *subj) {
+	subj->next = scr->stack[ws];
+	subj->prev = NULL;
+
+	if (scr->stack[ws]) {
+		scr->stack[ws]->prev = subj;
+	}
+
+	scr->stack[ws] = subj;
+}
+
+static window *excise(int ws, window *subj) {
+	if (subj->next) {
+		subj->next->prev = subj->prev;
+	}
+
+	if (subj->prev) {
+		subj->prev->next = subj->next;
+	} else {
+		scr->stack[ws] = subj->next;
+	}
+
+	return subj;
+}
+
+static window *ws_wtf(xcb_window_t id, int ws) {
+	window *cur;
+	for (cur = scr->stack[ws]; cur; cur = cur->next) {
+		if (cur->child == id) {
+			break;
+		}
+	}
+	return cur;
+}
+
+static window *scr_wtf(screen *on, xcb_window_t id, int *ws) {
+	screen *prev = scr;
+	scr = on;
+
+	window *ret;
+	for (int i = 0; i <= STICKY; i++) {
+		ret = ws_wtf(id, i);
+		if (ret) {
+			if (ws) {
+				*ws = i;
+			}
+			break;
+		}
+	}
+
+	scr = prev;
+	return ret;
+}
+
+/* windows can be on any screen, and whatever is done to one happens on its screen */
+static window *all_wtf(xcb_window_t id, int *ws) {
+	for (unsigned int i = 0; i < screens_len; i++) {
+		window *ret = scr_wtf(&screens[i], id, ws);
+		if (ret) {
+			scr = &screens[i];
+			return ret;
+		}
+	}
+	return NULL;
+}
+
+static void ignore_unmap(window *subj) {
+	emit(CMD_UNMAP, subj->child);
+	subj->ignore_unmap = 1;
+}
+
+static void map(window *subj) {
+	emit(CMD_MAP, subj->child);
+}
+
+static void select_events(window *subj) {
+	emit(CMD_EVENTS, subj->child);
+}
+
+static void configure(window *subj, uint16_t mask) {
+	command *cmd = emit(CMD_CONFIGURE, subj->child);
+	cmd->mask = mask;
+	cmd->x = subj->geom.x;
+	cmd->y = subj->geom.y;
+	cmd->width = subj->geom.width;
+	cmd->height = subj->geom.height;
+	cmd->border = BORDER;
+}
+
+static void move_resize(window *subj, int x, int y, int w, int h) {
+	subj->geom.x = x;
+	subj->geom.y = y;
+	subj->geom.width = w;
+	subj->geom.height = h;
+	configure(subj, GEOM_MASK);
+}
+
+static void move(window *subj, int x, int y) {
+	subj->geom.x = x;
+	subj->geom.y = y;
+	configure(subj, XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y);
+}
+
+static void resize(window *subj, int w, int h) {
+	subj->geom.width = w;
+	subj->geom.height = h;
+	configure(subj, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT);
+}
+
+static void traverse(window *list, void (*func)(window *)) {
+	for (; list;) {
+		window *temp = list;
+		list = temp->next;
+		func(temp);
+	}
+}
+
+void core_grab_keys(void (*func)(uint16_t mod, xcb_keysym_t key)) {
+	for (int i = 0; i < LEN(keys); i++) {
+		func(keys[i].mod, keys[i].key);
+	}
+}
+
+void core_grab_buttons(void (*func)(uint16_t mod, uint32_t button)) {
+	for (int i = 0; i < LEN(buttons); i++) {
+		func(buttons[i].mod, buttons[i].button);
+	}
+}
+
+static void color(window *subj, uint32_t val) {
+	emit(CMD_COLOR, subj->child)->val = val;
+}
+
+static void input_focus(window *subj) {
+	emit(CMD_FOCUS, subj->child);
+}
+
+static void focus(window *subj) {
+	if (subj == scr->fwin[scr->curws]) {
+		return;
+	}
+
+	if (scr->fwin[scr->curws]) {
+		color(scr->fwin[scr->curws], UNFOCUSCOL);
+	}
+
+	color(subj, FOCUSCOL);
+
+	//other screens only remember what to focus once the pointer gets there
+	if (scr == focus_scr) {
+		input_focus(subj);
+	}
+	scr->fwin[scr->curws] = subj;
+}
+
+static int layer(window *subj) {
+	return subj->is_i_full || subj->is_e_full ? LAYER_FULLSCREEN : subj->layer;
+}
+
+static void unlink_order(window *subj) {
+	if (subj->down) {
+		subj->down->up = subj->up;
+	}
+
+	if (subj->up) {
+		subj->up->down = subj->down;
+	} else if (scr->top == subj) {
+		scr->top = subj->down;
+	}
+
+	subj->up = NULL;
+	subj->down = NULL;
+}
+
+/* move subj directly below above, or to the very top, with one request */
+static void place(window *subj, window *above) {
+	if ((subj->up || scr->top == subj) && subj->up == above) {
+		return;
+	}
+
+	unlink_order(subj);
+
+	command *cmd = emit(CMD_RESTACK, subj->child);
+	if (above) {
+		cmd->sibling = above->child;
+		cmd->stack_mode = XCB_STACK_MODE_BELOW;
+
+		subj->down = above->down;
+		above->down = subj;
+	} else {
+		cmd->sibling = scr->top ? scr->top->child : XCB_NONE;
+		cmd->stack_mode = XCB_STACK_MODE_ABOVE;
+
+		subj->down = scr->top;
+		scr->top = subj;
+	}
+
+	subj->up = above;
+	if (subj->down) {
+		subj->down->up = subj;
+	}
+}
+
+//the lowest window in a higher layer, or the lowest in the same one
+static window *ceiling(window *subj, int same) {
+	window *ret = NULL;
+	for (window *cur = scr->top; cur; cur = cur->down) {
+		if (cur == subj) {
+			continue;
+		}
+
+		if (layer(cur) < layer(subj) || (!same && layer(cur) == layer(subj))) {
+			break;
+		}
+
+		ret = cur;
+	}
+	return ret;
+}
+
+static void stack_top(window *subj) {
+	place(subj, ceiling(subj, 0));
+}
+
+static void stack_bottom(window *subj) {
+	place(subj, ceiling(subj, 1));
+}
+
+static void raise(window *subj) {
+	if (subj != scr->stack[scr->curws]) {
+		insert(scr->curws, excise(scr->curws, subj));
+	}
+
+	stack_top(subj);
+}
+
+/* follow a restack asked for by a client, but only within its layer */
+static void restack(window *subj, window *sibling, uint8_t mode) {
+	if (sibling && (sibling == subj || layer(sibling) != layer(subj))) {
+		sibling = NULL;
+	}
+
+	if (mode == XCB_STACK_MODE_OPPOSITE) {
+		int is_top = !subj->up || layer(subj->up) > layer(subj);
+		mode = is_top ? XCB_STACK_MODE_BELOW : XCB_STACK_MODE_ABOVE;
+	}
+
+	//there is no occlusion in the model, so the conditional modes always apply
+	if (mode == XCB_STACK_MODE_ABOVE || mode == XCB_STACK_MODE_TOP_IF) {
+		if (!sibling) {
+			stack_top(subj);
+		} else {
+			place(subj, sibling->up == subj ? subj->up : sibling->up);
+		}
+	} else {
+		if (!sibling) {
+			stack_bottom(subj);
+		} else {
+			place(subj, sibling);
+		}
+	}
+}
+
+static void center_pointer(window *subj) {
+	command *cmd = emit(CMD_WARP, subj->child);
+	cmd->x = (subj->geom.width + 2 * BORDER)/2;
+	cmd->y = (subj->geom.height + 2 * BORDER)/2;
+}
+
+static void close(int arg) {
+	if (scr->fwin[scr->curws]) {
+		emit(CMD_CLOSE, scr->fwin[scr->curws]->child)->val = scr->fwin[scr->curws]->protocols;
+	}
+}
+
+static void cycle_raise(window *cur) {
+	for (; cur != scr->fwin[scr->curws];) {
+		window *temp = cur->prev;
+		raise(cur);
+		cur = temp;
+	}
+}
+
+static void stop_cycle() {
+	state = DEFAULT;
+	emit(CMD_UNGRAB_KEYBOARD, XCB_NONE);
+}
+
+static void cycle(int arg) {
+	if (!scr->stack[scr->curws] || !scr->stack[scr->curws]->next) {
+		return;
+	}
+
+	//one grab hears the modifier go up, whichever window has the focus
+	if (state != CYCLE) {
+		emit(CMD_GRAB_KEYBOARD, scr->root);
+		marker = scr->fwin[scr->curws];
+		state = CYCLE;
+	}
+
+	if (!marker) {
+		return;
+	}
+
+	if (marker->next) {
+		cycle_raise(marker);
+		marker = scr->fwin[scr->curws];
+		center_pointer(marker->next);
+		raise(marker->next);
+	} else {
+		cycle_raise(marker);
+		center_pointer(scr->stack[scr->curws]);
+		marker = scr->fwin[scr->curws];
+	}
+
+	focus(scr->stack[scr->curws]);
+}
+
+static void change_ws(int arg) {
+	if (arg == scr->curws) {
+		return;
+	}
+
+	traverse(scr->stack[arg], map);
+	traverse(scr->stack[scr->curws], ignore_unmap);
+
+	scr->curws = arg;
+
+	if (scr->fwin[scr->curws]) {
+		input_focus(scr->fwin[scr->curws]);
+	}
+}
+
+static void send_ws(int arg) {
+	if (!scr->fwin[scr->curws] || arg == scr->curws) {
+		return;
+	}
+
+	window *subj = scr->fwin[scr->curws];
+
+	stack_top(subj);
+
+	subj->ignore_unmap = 1;
+	insert(arg, excise(scr->curws, subj));
+	emit(CMD_UNMAP, subj->child);
+
+	if (scr->fwin[arg]) {
+		color(subj, UNFOCUSCOL);
+	} else {
+		scr->fwin[arg] = subj;
+	}
+
+	scr->fwin[scr->curws] = NULL;
+	if (scr->stack[scr->curws]) {
+		focus(scr->stack[scr->curws]);
+	}
+}
+
+static void save_state(window *win, xcb_rectangle_t *state) {
+	*state = win->geom;
+}
+
+static void snap_save_state(window *win) {
+	save_state(win, &win->snap);
+
+	win->is_snap = 1;
+}
+
+#define SNAP_TEMPLATE(A, B, C, D, E) static xcb_rectangle_t A##_rect() {       \
+	return (xcb_rectangle_t){ B, C, D, E };                                 \
+}                                                                               \
+                                                                                \
+static void A(int arg) {                                                        \
+	window *subj = scr->fwin[scr->curws];                                   \
+	if (!subj || subj->is_e_full || subj->is_i_full) {                      \
+		return;                                                         \
+	}                                                                       \
+	                                                                        \
+	if (!subj->is_snap) {                                                   \
+		snap_save_state(subj);                                          \
+	}                                                                       \
+	                                                                        \
+	xcb_rectangle_t rect = A##_rect();                                      \
+	move_resize(subj, rect.x, rect.y, rect.width, rect.height);             \
+	                                                                        \
+	if (state == MOVE) {                                                    \
+		return;                                                         \
+	}                                                                       \
+	                                                                        \
+	center_pointer(subj);                                                   \
+	raise(subj);                                                            \
+}
+
+#ifndef SNAP_MAX_SMART
+SNAP_TEMPLATE(snap_max,
+	scr->area.x + GAP,
+	scr->area.y + GAP,
+	scr->area.width - 2 * GAP - 2 * BORDER,
+	scr->area.height - 2 * GAP - 2 * BORDER)
+#endif
+#ifdef SNAP_MAX_SMART
+SNAP_TEMPLATE(snap_max,
+	scr->area.x,
+	scr->area.y,
+	scr->area.width - 2 * BORDER,
+	scr->area.height - 2 * BORDER)
+#endif
+
+SNAP_TEMPLATE(snap_l,
+	scr->area.x + GAP,
+	scr->area.y + GAP,
+	scr->area.width / 2 - 1.5 * GAP - BORDER * 2,
+	scr->area.height - 2 * GAP - 2 * BORDER)
+
+SNAP_TEMPLATE(snap_lu,
+	scr->area.x + GAP,
+	scr->area.y + GAP,
+	scr->area.width / 2 - 1.5 * GAP - BORDER * 2,
+	scr->area.height / 2 - 1.5 * GAP - 2 * BORDER)
+
+SNAP_TEMPLATE(snap_ld,
+	scr->area.x + GAP,
+	scr->area.y + scr->area.height / 2 + GAP / 2,
+	scr->area.width / 2 - 1.5 * GAP - BORDER * 2,
+	scr->area.height / 2 - 1.5 * GAP - 2 * BORDER)
+
+SNAP_TEMPLATE(snap_r,
+	scr->area.x + scr->area.width / 2 + GAP / 2,
+	scr->area.y + GAP,
+	scr->area.width / 2 - 1.5 * GAP - BORDER * 2,
+	scr->area.height - 2 * GAP - 2 * BORDER)
+
+SNAP_TEMPLATE(snap_ru,
+	scr->area.x + scr->area.width / 2 + GAP / 2,
+	scr->area.y + GAP,
+	scr->area.width / 2 - 1.5 * GAP - BORDER * 2,
+	scr->area.height / 2 - 1.5 * GAP - 2 * BORDER)
+
+SNAP_TEMPLATE(snap_rd,
+	scr->area.x + scr->area.width / 2 + GAP / 2,
+	scr->area.y + scr->area.height / 2 + GAP / 2,
+	scr->area.width / 2 - 1.5 * GAP - BORDER * 2,
+	scr->area.height / 2 - 1.5 * GAP - 2 * BORDER)
+
+/* only the visible workspace is reordered, elsewhere the window just goes on top of its layer */
+static void full_save_state(window *win, int ws) {
+	if (ws == scr->curws) {
+		raise(win);
+	} else {
+		stack_top(win);
+	}
+
+	save_state(win, &win->full);
+}
+
+static void full_restore_state(window *win) {
+	move_resize(win, win->full.x, win->full.y, win->full.width, win->full.height);
+
+	stack_top(win);
+}
+
+static void full(window *win) {
+	move_resize(win, -BORDER, -BORDER, scr->width, scr->height);
+}
+
+static void int_full(int arg) {
+	if (!scr->fwin[scr->curws]) {
+		return;
+	}
+
+	scr->fwin[scr->curws]->is_i_full = !scr->fwin[scr->curws]->is_i_full;
+
+	if (scr->fwin[scr->curws]->is_e_full) {
+		return;
+	}
+
+	if (!scr->fwin[scr->curws]->is_i_full) {
+		full_restore_state(scr->fwin[scr->curws]);
+		return;
+	}
+
+	full_save_state(scr->fwin[scr->curws], scr->curws);
+
+	full(scr->fwin[scr->curws]);
+}
+
+static void ext_full(window *subj, int ws) {
+	subj->is_e_full = !subj->is_e_full;
+
+	if (!subj->is_e_full) {
+		if (!subj->is_i_full) {
+			full_restore_state(subj);
+		}
+
+		return;
+	}
+
+	if (!subj->is_i_full) {
+		full_save_state(subj, ws);
+	}
+
+	full(subj);
+}
+
+static int spend(bucket *b) {
+	b->tokens += (clock_ms - b->stamp) * RATE / 1000.0;
+	if (b->tokens > BURST) {
+		b->tokens = BURST;
+	}
+	b->stamp = clock_ms;
+
+	if (b->tokens < 1) {
+		return 0;
+	}
+
+	b->tokens -= 1;
+	return 1;
+}
+
+/* when the next token comes in, if that is sooner than wake */
+static uint64_t refilled(bucket *b, uint64_t wake) {
+	uint64_t at = clock_ms + (1 - b->tokens) * 1000 / RATE + 1;
+	return !wake || at < wake ? at : wake;
+}
+
+/* once a window runs dry, everything it asks for waits for core_tick */
+static int take_token(window *subj) {
+	if (!subj->deferred) {
+		if (spend(&subj->rate)) {
+			return 1;
+		}
+
+		emit(CMD_THROTTLE, subj->child);
+		throttled++;
+	}
+
+	subj->deferred++;
+	return 0;
+}
+
+void core_fullscreen(xcb_window_t win, int action) {
+	int ws;
+	window *found = all_wtf(win, &ws);
+	if (!found || ws == STICKY || action > STATE_TOGGLE) {
+		return;
+	}
+
+	int is = found->pending_full >= 0 ? found->pending_full : found->is_e_full;
+	int want = action == STATE_TOGGLE ? !is : action == STATE_ADD;
+
+	if (!take_token(found)) {
+		found->pending_full = want;
+		return;
+	}
+
+	if (want != found->is_e_full) {
+		ext_full(found, ws);
+	}
+}
+
+void core_layer(xcb_window_t win, int layer, int action) {
+	int ws;
+	window *found = all_wtf(win, &ws);
+	if (!found || ws == STICKY || action > STATE_TOGGLE) {
+		return;
+	}
+
+	int is = found->layer == layer;
+	int want = action == STATE_TOGGLE ? !is : action == STATE_ADD;
+	if (want == is) {
+		return;
+	}
+
+	found->layer = want ? layer : LAYER_NORMAL;
+	stack_top(found);
+}
+
+void core_restack(xcb_window_t win, xcb_window_t sibling, uint8_t mode) {
+	window *found = all_wtf(win, NULL);
+	if (found) {
+		restack(found, scr_wtf(scr, sibling, NULL), mode);
+	}
+}
+
+//rules chained by the hash of their class, rule i is stored as i + 1 so that 0 ends a chain,
+//the entry ending the table is never chained
+#define RULES (LEN(rules) - 1)
+#define RULE_SLOTS (2 * RULES + 1)
+
+static unsigned int rule_slot[RULE_SLOTS];
+static unsigned int rule_next[LEN(rules)];
+static unsigned int rule_any = 0;
+
+//which rectangle each snap binding stands for, so rules can name the bindings
+static const struct {
+	void (*bind)(int arg);
+	xcb_rectangle_t (*rect)(void);
+} zones[] = {
+	{ snap_max, snap_max_rect },
+	{ snap_l,   snap_l_rect   },
+	{ snap_lu,  snap_lu_rect  },
+	{ snap_ld,  snap_ld_rect  },
+	{ snap_r,   snap_r_rect   },
+	{ snap_ru,  snap_ru_rect  },
+	{ snap_rd,  snap_rd_rect  },
+};
+
+static unsigned int hash(const char *str) {
+	unsigned int ret = 5381;
+	for (; *str; str++) {
+		ret = ret * 33 + (unsigned char)*str;
+	}
+	return ret;
+}
+
+static int rule_matches(const rule *r, properties *props) {
+	if (r->type != TYPE_ANY && r->type != props->type) {
+		return 0;
+	}
+
+	if (r->role && (!props->role || strcmp(r->role, props->role))) {
+		return 0;
+	}
+
+	return !r->class || (props->class && !strcmp(r->class, props->class));
+}
+
+static unsigned int first_match(unsigned int cur, properties *props) {
+	for (; cur; cur = rule_next[cur - 1]) {
+		if (rule_matches(&rules[cur - 1], props)) {
+			break;
+		}
+	}
+	return cur;
+}
+
+/* only rules for the window's class and those for any class are looked at */
+static const rule *match(properties *props) {
+	unsigned int best = first_match(rule_any, props);
+
+	if (props->class) {
+		unsigned int slot = rule_slot[hash(props->class) % RULE_SLOTS];
+		unsigned int by_class = first_match(slot, props);
+		if (by_class && (!best || by_class < best)) {
+			best = by_class;
+		}
+	}
+
+	return best ? &rules[best - 1] : NULL;
+}
+
+/* shape a new window before its first configure, so rules cost no extra requests */
+static void apply_rule(window *win, const rule *r) {
+	if (r->full) {
+		win->full = win->geom;
+		win->is_i_full = 1;
+		win->geom = (xcb_rectangle_t){ -BORDER, -BORDER, scr->width, scr->height };
+		return;
+	}
+
+	for (int i = 0; r->snap && i < LEN(zones); i++) {
+		if (zones[i].bind == r->snap) {
+			win->snap = win->geom;
+			win->is_snap = 1;
+			win->geom = zones[i].rect();
+			break;
+		}
+	}
+}
+
+static uint32_t size_helper(uint32_t win_sze, uint32_t scr_sze) {
+	return win_sze > scr_sze ? scr_sze : win_sze;
+}
+
+static uint32_t place_helper(uint32_t ptr_pos, uint32_t win_sze, uint32_t scr_sze) {
+	if (ptr_pos < win_sze / 2 + BORDER) {
+		return 0;
+	} else if (ptr_pos + win_sze / 2 + BORDER > scr_sze) {
+		return scr_sze - win_sze - 2 * BORDER;
+	} else {
+		return ptr_pos - win_sze / 2 - BORDER;
+	}
+}
+
+static uint32_t clamp(uint32_t val, uint32_t max) {
+	return val > max ? max : val;
+}
+
+/* shrink the screen by the struts of all docks, tell the backend if that moved anything */
+static void update_area(void) {
+	uint32_t strut[4] = { 0, 0, 0, 0 };
+	for (window *cur = scr->stack[STICKY]; cur; cur = cur->next) {
+		for (int i = 0; i < 4; i++) {
+			if (cur->strut[i] > strut[i]) {
+				strut[i] = cur->strut[i];
+			}
+		}
+	}
+
+	xcb_rectangle_t next;
+	next.x = clamp(strut[0], scr->width / 2);
+	next.y = clamp(strut[2], scr->height / 2);
+	next.width = scr->width - next.x - clamp(strut[1], scr->width / 2);
+	next.height = scr->height - next.y - clamp(strut[3], scr->height / 2);
+
+	if (!memcmp(&next, &scr->area, sizeof(scr->area))) {
+		return;
+	}
+
+	scr->area = next;
+
+	command *cmd = emit(CMD_WORKAREA, scr->root);
+	cmd->x = scr->area.x;
+	cmd->y = scr->area.y;
+	cmd->width = scr->area.width;
+	cmd->height = scr->area.height;
+	cmd->val = NUM_WS;
+}
+
+int core_is_managed(xcb_window_t win) {
+	for (unsigned int i = 0; i < screens_len; i++) {
+		if (scr_wtf(&screens[i], win, NULL)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+xcb_window_t core_focused(void) {
+	window *subj = focus_scr->fwin[focus_scr->curws];
+	return subj ? subj->child : XCB_NONE;
+}
+
+void core_screen(xcb_window_t root) {
+	for (unsigned int i = 0; i < screens_len; i++) {
+		if (screens[i].root == root) {
+			scr = &screens[i];
+			break;
+		}
+	}
+}
+
+static departed *gone_wtf(xcb_window_t win) {
+	for (unsigned int i = 0; i < DEPARTED; i++) {
+		if (gone[i].win == win) {
+			return &gone[i];
+		}
+	}
+	return NULL;
+}
+
+static void settle(departed *d) {
+	if (d->waiting) {
+		d->waiting = 0;
+		throttled--;
+	}
+}
+
+static void depart(window *subj) {
+	departed *d = &gone[gone_next];
+	gone_next = (gone_next + 1) % DEPARTED;
+
+	//the oldest entry makes room, a map still waiting on it goes ahead
+	if (d->waiting) {
+		settle(d);
+		emit(CMD_ADOPT, d->win);
+	}
+
+	d->win = subj->child;
+	d->rate = subj->rate;
+}
+
+/* whether the backend may adopt a window now, or must wait for CMD_ADOPT */
+int core_admit(xcb_window_t win) {
+	departed *d = gone_wtf(win);
+	if (!d || spend(&d->rate)) {
+		return 1;
+	}
+
+	if (!d->waiting) {
+		d->waiting = 1;
+		throttled++;
+		emit(CMD_THROTTLE, win);
+	}
+	return 0;
+}
+
+void core_map_request(xcb_window_t win_id, properties *props, xcb_rectangle_t *geom,
+		int16_t ptr_x, int16_t ptr_y) {
+	if (all_wtf(win_id, NULL)) {
+		return;
+	}
+
+	const rule *r = match(props);
+	if (r && r->unmanaged) {
+		emit(CMD_MAP, win_id);
+		return;
+	}
+
+	window *win = malloc(sizeof(window));
+	win->up = NULL;
+	win->down = NULL;
+	win->child = win_id;
+	win->protocols = props->protocols;
+	win->ignore_unmap = 0;
+	win->rate = (bucket){ BURST, clock_ms };
+
+	//mapping again carries on with what it had left
+	departed *d = gone_wtf(win_id);
+	if (d) {
+		win->rate = d->rate;
+		settle(d);
+		d->win = XCB_NONE;
+	}
+	win->deferred = 0;
+	win->pending.mask = 0;
+	win->pending_full = -1;
+	win->is_snap = 0;
+	win->is_e_full = 0;
+	win->is_i_full = 0;
+	memcpy(win->strut, props->strut, sizeof(win->strut));
+
+	//docks stay where they asked to be, in their own layer on every workspace
+	if (props->type == TYPE_DOCK || props->type == TYPE_DESKTOP) {
+		win->layer = props->type == TYPE_DOCK ? LAYER_DOCK : LAYER_DESKTOP;
+		win->geom = *geom;
+		insert(STICKY, win);
+		stack_top(win);
+		map(win);
+		update_area();
+		return;
+	}
+
+	win->layer = LAYER_NORMAL;
+
+	xcb_rectangle_t *area = &scr->area;
+	uint32_t w = size_helper(geom->width, area->width);
+	uint32_t h = size_helper(geom->height, area->height);
+	uint32_t x = area->x + place_helper(ptr_x > area->x ? ptr_x - area->x : 0, w, area->width);
+	uint32_t y = area->y + place_helper(ptr_y > area->y ? ptr_y - area->y : 0, h, area->height);
+	win->geom = (xcb_rectangle_t){ x, y, w, h };
+
+	int ws = scr->curws;
+	if (r) {
+		apply_rule(win, r);
+		if (r->ws >= 0 && r->ws < NUM_WS) {
+			ws = r->ws;
+		}
+	}
+
+	configure(win, GEOM_MASK | XCB_CONFIG_WINDOW_BORDER_WIDTH);
+
+	select_events(win);
+
+	insert(ws, win);
+	stack_top(win);
+
+	//elsewhere it waits unmapped until its workspace is shown
+	if (ws != scr->curws) {
+		color(win, scr->fwin[ws] ? UNFOCUSCOL : FOCUSCOL);
+		if (!scr->fwin[ws]) {
+			scr->fwin[ws] = win;
+		}
+		return;
+	}
+
+	color(win, UNFOCUSCOL);
+
+	map(win);
+
+	if (!state) {
+		focus(win);
+	}
+}
+
+void core_set_protocols(xcb_window_t win, uint32_t protocols) {
+	window *found = all_wtf(win, NULL);
+	if (found) {
+		found->protocols = protocols;
+	}
+}
+
+void core_set_strut(xcb_window_t win, const uint32_t *strut) {
+	int ws;
+	window *found = all_wtf(win, &ws);
+	if (!found || !memcmp(found->strut, strut, sizeof(found->strut))) {
+		return;
+	}
+
+	memcpy(found->strut, strut, sizeof(found->strut));
+	if (ws == STICKY) {
+		update_area();
+	}
+}
+
+void core_enter_notify(xcb_window_t win) {
+	window *found = ws_wtf(win, scr->curws);
+	if (!found) {
+		return;
+	}
+
+	//crossing onto another screen takes the input focus along
+	if (scr != focus_scr) {
+		focus_scr = scr;
+		if (found == scr->fwin[scr->curws]) {
+			input_focus(found);
+		}
+	}
+
+	focus(found);
+}
+
+static int move_resize_helper(xcb_window_t win) {
+	window *found = ws_wtf(win, scr->curws);
+	if (!found || found != scr->fwin[scr->curws]) {
+		return 0;
+	}
+
+	raise(scr->fwin[scr->curws]);
+
+	if (scr->fwin[scr->curws]->is_e_full || scr->fwin[scr->curws]->is_i_full) {
+		return 0;
+	}
+
+	return 1;
+}
+
+static void grab_pointer() {
+	drag = scr->fwin[scr->curws];
+	drag_scr = scr;
+	emit(CMD_GRAB, scr->root);
+}
+
+static void mouse_move(xcb_window_t win, uint32_t event_x, uint32_t event_y) {
+	if (!move_resize_helper(win)) {
+		return;
+	}
+
+	xcb_rectangle_t *geom = &scr->fwin[scr->curws]->geom;
+
+	if (scr->fwin[scr->curws]->is_snap) {
+		x = scr->fwin[scr->curws]->snap.width * (event_x - geom->x) / geom->width;
+		y = scr->fwin[scr->curws]->snap.height * (event_y - geom->y) / geom->height;
+	} else {
+		x = event_x - geom->x;
+		y = event_y - geom->y;
+	}
+
+	state = MOVE;
+
+	grab_pointer();
+}
+
+static void mouse_resize(xcb_window_t win, uint32_t event_x, uint32_t event_y) {
+	if (!move_resize_helper(win)) {
+		return;
+	}
+
+	xcb_rectangle_t *geom = &scr->fwin[scr->curws]->geom;
+
+	scr->fwin[scr->curws]->is_snap = 0;
+	x = geom->width - event_x;
+	y = geom->height - event_y;
+
+	state = RESIZE;
+
+	grab_pointer();
+}
+
+void core_button_press(xcb_window_t win, uint32_t button, uint16_t mod, int16_t x, int16_t y) {
+	for (int i = 0; i < LEN(buttons); i++) {
+		if (button == buttons[i].button && buttons[i].mod == mod) {
+			buttons[i].function(win, x, y);
+			break;
+		}
+	}
+}
+
+static void mouse_snap(uint32_t ptr_pos, uint32_t tolerance, void (*snap_x)(int arg),
+		void (*snap_y)(int arg), void (*snap_z)(int arg)) {
+	if (ptr_pos < SNAP_CORNER) {
+		snap_x(0);
+	} else if (ptr_pos > tolerance - SNAP_CORNER) {
+		snap_y(0);
+	} else {
+		snap_z(0);
+	}
+}
+
+void core_motion_notify(int16_t root_x, int16_t root_y) {
+	if (scr != drag_scr || !drag || drag != scr->fwin[scr->curws]) {
+		return;
+	}
+
+	if (state == MOVE) {
+		if (root_x < SNAP_MARGIN) {
+			mouse_snap(root_y, scr->height, snap_lu, snap_ld, snap_l);
+		} else if (root_y < SNAP_MARGIN) {
+			mouse_snap(root_x, scr->width, snap_lu, snap_ru, snap_max);
+		} else if (root_x > scr->width - SNAP_MARGIN) {
+			mouse_snap(root_y, scr->height, snap_ru, snap_rd, snap_r);
+		} else if (root_y > scr->height - SNAP_MARGIN) {
+			mouse_snap(root_x, scr->width, snap_ld, snap_rd, snap_max);
+		} else {
+			window *subj = drag;
+
+			//leaving a snap restores the size and follows the pointer in one go
+			if (subj->is_snap) {
+				subj->is_snap = 0;
+				move_resize(subj, root_x - x, root_y - y, subj->snap.width,
+						subj->snap.height);
+			} else {
+				move(subj, root_x - x, root_y - y);
+			}
+		}
+	} else if (state == RESIZE) {
+		resize(drag, root_x + x, root_y + y);
+	}
+}
+
+void core_button_release(void) {
+	if (state != MOVE && state != RESIZE) {
+		return;
+	}
+
+	emit(CMD_UNGRAB, XCB_NONE);
+	state = DEFAULT;
+	drag = NULL;
+	drag_scr = NULL;
+}
+
+void core_key_press(xcb_keysym_t keysym, uint16_t mod) {
+	if (keysym != XK_Tab && state == CYCLE) {
+		stop_cycle();
+	}
+
+	for (int i = 0; i < LEN(keys); i++) {
+		if (keysym == keys[i].key && keys[i].mod == mod) {
+			keys[i].function(keys[i].arg);
+			break;
+		}
+	}
+}
+
+void core_key_release(xcb_keysym_t keysym) {
+	if (keysym == XK_Super_L && state == CYCLE) {
+		stop_cycle();
+	}
+}
+
+static void forget_client(window *subj, int ws) {
+	if ((state == MOVE || state == RESIZE) && subj == drag) {
+		core_button_release();
+	}
+
+	if (subj->deferred) {
+		throttled--;
+	}
+
+	unlink_order(subj);
+	free(excise(ws, subj));
+
+	if (ws == STICKY) {
+		update_area();
+	}
+
+	if (scr->fwin[ws] != subj) {
+		return;
+	}
+
+	scr->fwin[ws] = NULL;
+
+	//a hidden workspace keeps a focus to come back to, only the visible one is focused now
+	if (ws == scr->curws && scr->stack[scr->curws]) {
+		focus(scr->stack[scr->curws]);
+	} else if (ws != scr->curws && ws != STICKY) {
+		scr->fwin[ws] = scr->stack[ws];
+	}
+}
+
+/* a window withdrawn before it was adopted no longer wants to be, a destroyed one is no more */
+static void withdraw(xcb_window_t win, int destroyed) {
+	departed *d = gone_wtf(win);
+	if (d) {
+		settle(d);
+		if (destroyed) {
+			d->win = XCB_NONE;
+		}
+	}
+}
+
+void core_unmap_notify(xcb_window_t win) {
+	int ws;
+	window *found = all_wtf(win, &ws);
+	if (!found) {
+		withdraw(win, 0);
+		return;
+	}
+
+	if (ws != scr->curws && ws != STICKY) {
+		return;
+	}
+
+	if (found->ignore_unmap) {
+		found->ignore_unmap = 0;
+	} else {
+		depart(found);
+		forget_client(found, ws);
+	}
+}
+
+void core_destroy_notify(xcb_window_t win) {
+	int ws;
+	window *found = all_wtf(win, &ws);
+	if (found) {
+		forget_client(found, ws);
+	} else {
+		withdraw(win, 1);
+	}
+}
+
+static void merge_geom(xcb_rectangle_t *geom, command *req) {
+	if (req->mask & XCB_CONFIG_WINDOW_X) {
+		geom->x = req->x;
+	}
+	if (req->mask & XCB_CONFIG_WINDOW_Y) {
+		geom->y = req->y;
+	}
+	if (req->mask & XCB_CONFIG_WINDOW_WIDTH) {
+		geom->width = req->width;
+	}
+	if (req->mask & XCB_CONFIG_WINDOW_HEIGHT) {
+		geom->height = req->height;
+	}
+}
+
+static void apply_configure(window *subj, command *req) {
+	if (req->mask & XCB_CONFIG_WINDOW_STACK_MODE) {
+		xcb_window_t sibling = req->mask & XCB_CONFIG_WINDOW_SIBLING ? req->sibling : XCB_NONE;
+		restack(subj, scr_wtf(scr, sibling, NULL), req->stack_mode);
+	}
+
+	if (subj->is_i_full || subj->is_e_full || !(req->mask & GEOM_MASK)) {
+		return;
+	}
+
+	merge_geom(&subj->geom, req);
+	configure(subj, req->mask & GEOM_MASK);
+}
+
+/* keep only the latest value of each field a throttled window asked for */
+static void defer_configure(window *subj, command *req) {
+	xcb_rectangle_t geom = {
+		subj->pending.x, subj->pending.y, subj->pending.width, subj->pending.height
+	};
+	merge_geom(&geom, req);
+
+	if (req->mask & XCB_CONFIG_WINDOW_STACK_MODE) {
+		subj->pending.mask &= ~STACK_MASK;
+		subj->pending.sibling = req->sibling;
+		subj->pending.stack_mode = req->stack_mode;
+	}
+
+	subj->pending.mask |= req->mask & (GEOM_MASK | STACK_MASK);
+	subj->pending.x = geom.x;
+	subj->pending.y = geom.y;
+	subj->pending.width = geom.width;
+	subj->pending.height = geom.height;
+}
+
+void core_configure_request(xcb_window_t win, command *req) {
+	window *found = all_wtf(win, NULL);
+
+	if (!found) {
+		req->type = CMD_CONFIGURE;
+		req->win = win;
+		*emit(CMD_CONFIGURE, win) = *req;
+	} else if (!take_token(found)) {
+		defer_configure(found, req);
+	} else {
+		apply_configure(found, req);
+	}
+}
+
+static void flush_deferred(window *subj, int ws) {
+	emit(CMD_THROTTLE, subj->child)->val = subj->deferred;
+	subj->deferred = 0;
+	throttled--;
+
+	apply_configure(subj, &subj->pending);
+	subj->pending.mask = 0;
+
+	if (subj->pending_full >= 0 && subj->pending_full != subj->is_e_full) {
+		ext_full(subj, ws);
+	}
+	subj->pending_full = -1;
+}
+
+/* let throttled windows spend what they have saved up, returns when to call again */
+uint64_t core_tick(uint64_t now) {
+	clock_ms = now;
+
+	screen *prev = scr;
+
+	uint64_t wake = 0;
+	for (unsigned int s = 0; s < screens_len && throttled; s++) {
+		scr = &screens[s];
+		for (int i = 0; i <= STICKY && throttled; i++) {
+			for (window *cur = scr->stack[i]; cur; cur = cur->next) {
+				if (!cur->deferred) {
+					continue;
+				}
+
+				if (spend(&cur->rate)) {
+					flush_deferred(cur, i);
+				} else {
+					wake = refilled(&cur->rate, wake);
+				}
+			}
+		}
+	}
+
+	for (unsigned int i = 0; i < DEPARTED && throttled; i++) {
+		departed *d = &gone[i];
+		if (!d->waiting) {
+			continue;
+		}
+
+		if (spend(&d->rate)) {
+			settle(d);
+			emit(CMD_ADOPT, d->win);
+		} else {
+			wake = refilled(&d->rate, wake);
+		}
+	}
+
+	scr = prev;
+	return wake;
+}
+
+static void cleanup(window *win) {
+	emit(CMD_CLOSE, win->child)->val = win->protocols;
+	free(win);
+}
+
+static void release(window *win) {
+	emit(CMD_MAP, win->child);
+	free(win);
+}
+
+static void forget(window *win) {
+	free(win);
+}
+
+/* chain every rule under its class, backwards so that chains keep the order of config.h */
+void core_init(void) {
+	for (unsigned int i = RULES; i > 0; i--) {
+		unsigned int *head = &rule_any;
+		if (rules[i - 1].class) {
+			head = &rule_slot[hash(rules[i - 1].class) % RULE_SLOTS];
+		}
+
+		rule_next[i - 1] = *head;
+		*head = i;
+	}
+}
+
+/* screens are only added before the first event, so nothing points into the array yet */
+void core_add_screen(xcb_window_t root, uint16_t width, uint16_t height) {
+	screens = realloc(screens, (screens_len + 1) * sizeof(screen));
+
+	scr = &screens[screens_len++];
+	memset(scr, 0, sizeof(screen));
+	scr->root = root;
+	scr->width = width;
+	scr->height = height;
+
+	focus_scr = &screens[0];
+
+	update_area();
+}
+
+/* close every window, or leave them all mapped for the next window manager */
+void core_die(int keep) {
+	for (unsigned int s = 0; s < screens_len; s++) {
+		scr = &screens[s];
+
+		for (int i = 0; i < NUM_WS; i++) {
+			if (!keep) {
+				traverse(scr->stack[i], cleanup);
+			} else if (i != scr->curws) {
+				traverse(scr->stack[i], release);
+			} else {
+				traverse(scr->stack[i], forget);
+			}
+			scr->stack[i] = NULL;
+			scr->fwin[i] = NULL;
+		}
+
+		traverse(scr->stack[STICKY], forget);
+		scr->stack[STICKY] = NULL;
+		scr->top = NULL;
+	}
+}
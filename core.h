@@ -0,0 +1,108 @@
+#include <xcb/xproto.h>
+
+/* the core never talks to X, it queues commands for the backend to carry out */
+
+enum {
+	CMD_CONFIGURE,
+	CMD_RESTACK,
+	CMD_MAP,
+	CMD_UNMAP,
+	CMD_FOCUS,
+	CMD_COLOR,
+	CMD_EVENTS,
+	CMD_WARP,
+	CMD_CLOSE,
+	CMD_GRAB,
+	CMD_UNGRAB,
+	CMD_GRAB_KEYBOARD,
+	CMD_UNGRAB_KEYBOARD,
+	CMD_WORKAREA,
+	//val is 0 as a window runs dry, then how many of its requests were coalesced
+	CMD_THROTTLE,
+	//a map request held back by core_admit may be carried out now
+	CMD_ADOPT,
+};
+
+enum {
+	TYPE_ANY = -1,
+	TYPE_NORMAL,
+	TYPE_DOCK,
+	TYPE_DESKTOP,
+	TYPE_DIALOG,
+	TYPE_UTILITY,
+	TYPE_SPLASH,
+};
+enum { STATE_REMOVE, STATE_ADD, STATE_TOGGLE, };
+enum { PROTO_DELETE = 1 << 0, PROTO_PING = 1 << 1, };
+
+/* bottom to top, a window never stacks above one in a higher layer */
+enum {
+	LAYER_DESKTOP,
+	LAYER_BELOW,
+	LAYER_NORMAL,
+	LAYER_ABOVE,
+	LAYER_DOCK,
+	LAYER_FULLSCREEN,
+};
+
+/* what the backend learned about a window from its properties */
+typedef struct {
+	int type;
+	uint32_t protocols;
+	uint32_t strut[4];
+
+	//only valid until core_map_request returns
+	const char *class;
+	const char *role;
+} properties;
+
+typedef struct {
+	uint8_t type;
+	uint16_t mask;
+
+	xcb_window_t win;
+	xcb_window_t sibling;
+	uint8_t stack_mode;
+
+	int16_t x;
+	int16_t y;
+	uint16_t width;
+	uint16_t height;
+	uint16_t border;
+
+	uint32_t val;
+} command;
+
+void core_init(void);
+void core_add_screen(xcb_window_t root, uint16_t width, uint16_t height);
+uint64_t core_tick(uint64_t now);
+void core_die(int keep);
+
+const command *core_commands(unsigned int *len);
+void core_clear(void);
+
+void core_grab_keys(void (*func)(uint16_t mod, xcb_keysym_t key));
+void core_grab_buttons(void (*func)(uint16_t mod, uint32_t button));
+
+int core_is_managed(xcb_window_t win);
+xcb_window_t core_focused(void);
+void core_screen(xcb_window_t root);
+
+int core_admit(xcb_window_t win);
+void core_map_request(xcb_window_t win, properties *props, xcb_rectangle_t *geom,
+		int16_t ptr_x, int16_t ptr_y);
+void core_set_protocols(xcb_window_t win, uint32_t protocols);
+void core_set_strut(xcb_window_t win, const uint32_t *strut);
+void core_unmap_notify(xcb_window_t win);
+void core_destroy_notify(xcb_window_t win);
+void core_enter_notify(xcb_window_t win);
+void core_configure_request(xcb_window_t win, command *req);
+void core_fullscreen(xcb_window_t win, int action);
+void core_layer(xcb_window_t win, int layer, int action);
+void core_restack(xcb_window_t win, xcb_window_t sibling, uint8_t mode);
+
+void core_key_press(xcb_keysym_t key, uint16_t mod);
+void core_key_release(xcb_keysym_t key);
+void core_button_press(xcb_window_t win, uint32_t button, uint16_t mod, int16_t x, int16_t y);
+void core_motion_notify(int16_t x, int16_t y);
+void core_button_release(void);
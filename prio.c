@@ -0,0 +1,101 @@
+#include <string.h>
+
+#include "prio.h"
+
+int prio_is_input(xcb_generic_event_t *ev) {
+	switch (ev->response_type & ~0x80) {
+		case XCB_KEY_PRESS:
+		case XCB_KEY_RELEASE:
+		case XCB_BUTTON_PRESS:
+		case XCB_BUTTON_RELEASE:
+		case XCB_MOTION_NOTIFY:
+		//crossings move the focus that keys act on, so they keep their place among input
+		case XCB_ENTER_NOTIFY:
+		//only XInput2 drags select extension events
+		case XCB_GE_GENERIC:
+			return 1;
+	}
+	return 0;
+}
+
+static xcb_window_t event_window(xcb_generic_event_t *ev) {
+	switch (ev->response_type & ~0x80) {
+		case XCB_BUTTON_PRESS:
+			return ((xcb_button_press_event_t *)ev)->child;
+		case XCB_MAP_REQUEST:
+			return ((xcb_map_request_event_t *)ev)->window;
+		case XCB_CONFIGURE_REQUEST:
+			return ((xcb_configure_request_event_t *)ev)->window;
+		case XCB_UNMAP_NOTIFY:
+			return ((xcb_unmap_notify_event_t *)ev)->window;
+		case XCB_DESTROY_NOTIFY:
+			return ((xcb_destroy_notify_event_t *)ev)->window;
+		case XCB_PROPERTY_NOTIFY:
+			return ((xcb_property_notify_event_t *)ev)->window;
+		case XCB_CLIENT_MESSAGE:
+			return ((xcb_client_message_event_t *)ev)->window;
+		case XCB_ENTER_NOTIFY:
+			return ((xcb_enter_notify_event_t *)ev)->event;
+	}
+	return XCB_NONE;
+}
+
+//keys can cycle or switch the whole workspace, so a managed window going away holds them back
+static int holds_keys(xcb_generic_event_t *ev, int (*managed)(xcb_window_t win)) {
+	switch (ev->response_type & ~0x80) {
+		case XCB_UNMAP_NOTIFY:
+		case XCB_DESTROY_NOTIFY:
+			return managed(event_window(ev));
+	}
+	return 0;
+}
+
+/*
+ * input jumps ahead of structural events until one of them concerns the window the
+ * input acts on, a clicked child or else the focused window, or for keys any managed
+ * window that goes away. from there on everything keeps arrival order, so input stays
+ * ordered among itself and per window.
+ */
+void prio_dispatch(xcb_generic_event_t **batch, unsigned int len, xcb_window_t (*focused)(void),
+		int (*managed)(xcb_window_t win), void (*dispatch)(xcb_generic_event_t *ev)) {
+	char done[PRIO_BATCH];
+	memset(done, 0, len);
+
+	int barrier = 0;
+	for (unsigned int i = 0; i < len && !barrier; i++) {
+		if (!prio_is_input(batch[i])) {
+			continue;
+		}
+
+		xcb_window_t win = event_window(batch[i]);
+		if (win == XCB_NONE) {
+			win = focused();
+		}
+
+		uint8_t type = batch[i]->response_type & ~0x80;
+		int key = type == XCB_KEY_PRESS || type == XCB_KEY_RELEASE;
+
+		for (unsigned int j = 0; j < i; j++) {
+			if (done[j]) {
+				continue;
+			}
+
+			if ((win != XCB_NONE && event_window(batch[j]) == win)
+					|| (key && holds_keys(batch[j], managed))) {
+				barrier = 1;
+				break;
+			}
+		}
+
+		if (!barrier) {
+			dispatch(batch[i]);
+			done[i] = 1;
+		}
+	}
+
+	for (unsigned int i = 0; i < len; i++) {
+		if (!done[i]) {
+			dispatch(batch[i]);
+		}
+	}
+}
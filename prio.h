@@ -0,0 +1,9 @@
+#include <xcb/xproto.h>
+
+/* largest batch prio_dispatch takes */
+#define PRIO_BATCH 256
+
+int prio_is_input(xcb_generic_event_t *ev);
+
+void prio_dispatch(xcb_generic_event_t **batch, unsigned int len, xcb_window_t (*focused)(void),
+		int (*managed)(xcb_window_t win), void (*dispatch)(xcb_generic_event_t *ev));
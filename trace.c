@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+/* records kept in the ring, the oldest are overwritten */
+#define TRACE_LEN 65536
+
+#define TRACE_MAGIC "araitrc2"
+
+typedef struct {
+	char magic[8];
+	uint64_t len;
+	uint64_t head;
+
+	uint32_t screens_len;
+	trace_screen_t screens[TRACE_SCREENS];
+} header;
+
+typedef struct {
+	uint64_t usec;
+	uint8_t ev[40];
+} record;
+
+static header *hdr = NULL;
+static record *ring = NULL;
+static size_t size = 0;
+
+static uint64_t pos = 0;
+static uint64_t start = 0;
+static uint64_t first = 0;
+
+static uint64_t now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int map_file(const char *path, int flags, int prot) {
+	int fd = open(path, flags, 0644);
+	if (fd < 0) {
+		return 0;
+	}
+
+	if (flags & O_CREAT) {
+		size = sizeof(header) + TRACE_LEN * sizeof(record);
+		if (ftruncate(fd, size)) {
+			close(fd);
+			return 0;
+		}
+	} else {
+		off_t end = lseek(fd, 0, SEEK_END);
+		if (end < (off_t)sizeof(header)) {
+			close(fd);
+			return 0;
+		}
+		size = end;
+	}
+
+	void *mem = mmap(NULL, size, prot, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		return 0;
+	}
+
+	hdr = mem;
+	ring = (record *)(hdr + 1);
+	return 1;
+}
+
+int trace_record_open(const char *path) {
+	if (!map_file(path, O_RDWR | O_CREAT | O_TRUNC, PROT_READ | PROT_WRITE)) {
+		return 0;
+	}
+
+	memcpy(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic));
+	hdr->len = TRACE_LEN;
+	hdr->head = 0;
+	hdr->screens_len = 0;
+	return 1;
+}
+
+/* screens live in the header, the ring would overwrite them */
+void trace_add_screen(xcb_window_t root, uint16_t width, uint16_t height) {
+	if (hdr->screens_len == TRACE_SCREENS) {
+		return;
+	}
+
+	trace_screen_t *scr = &hdr->screens[hdr->screens_len++];
+	scr->root = root;
+	scr->width = width;
+	scr->height = height;
+}
+
+void trace_record(xcb_generic_event_t *ev) {
+	//extension events do not fit a record
+	if ((ev->response_type & ~0x80) == XCB_GE_GENERIC) {
+		return;
+	}
+
+	record *rec = &ring[hdr->head % hdr->len];
+	rec->usec = now();
+	memset(rec->ev, 0, sizeof(rec->ev));
+	memcpy(rec->ev, ev, sizeof(xcb_generic_event_t));
+	hdr->head++;
+}
+
+void trace_record_reply(const void *reply) {
+	record *rec = &ring[hdr->head % hdr->len];
+	rec->usec = now();
+	memcpy(rec->ev, reply, sizeof(rec->ev));
+	hdr->head++;
+}
+
+int trace_replay_open(const char *path) {
+	if (!map_file(path, O_RDONLY, PROT_READ)) {
+		return 0;
+	}
+
+	//the ring has to fit the file without the multiplication wrapping, and hold something
+	if (memcmp(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic))
+			|| !hdr->len || hdr->len > (size - sizeof(header)) / sizeof(record)
+			|| !hdr->head || !hdr->screens_len || hdr->screens_len > TRACE_SCREENS) {
+		trace_close();
+		return 0;
+	}
+
+	pos = hdr->head > hdr->len ? hdr->head - hdr->len : 0;
+	first = ring[pos % hdr->len].usec;
+	start = now();
+	return 1;
+}
+
+const trace_screen_t *trace_screens(unsigned int *len) {
+	*len = hdr->screens_len;
+	return hdr->screens;
+}
+
+xcb_generic_event_t *trace_replay(int fast) {
+	if (pos >= hdr->head) {
+		return NULL;
+	}
+
+	record *rec = &ring[pos++ % hdr->len];
+
+	if (!fast) {
+		uint64_t due = start + rec->usec - first;
+		uint64_t cur = now();
+		if (due > cur) {
+			usleep(due - cur);
+		}
+	}
+
+	//replies take the whole record
+	xcb_generic_event_t *ev = malloc(sizeof(rec->ev));
+	if (ev) {
+		memcpy(ev, rec->ev, sizeof(rec->ev));
+	}
+	return ev;
+}
+
+void trace_close(void) {
+	if (hdr) {
+		munmap(hdr, size);
+	}
+	hdr = NULL;
+	ring = NULL;
+}
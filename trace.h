@@ -0,0 +1,52 @@
+#include <xcb/xcb.h>
+
+/* screens a trace remembers, a replay maps them onto its own in order */
+#define TRACE_SCREENS 8
+
+/* replies never come in as events, so their type marks what the backend learned from one */
+#define TRACE_REPLY 1
+
+enum { TRACE_ADOPT, TRACE_NAMES, TRACE_PROTOCOLS, TRACE_STRUT, TRACE_POINTER, };
+
+typedef struct {
+	xcb_window_t root;
+	uint16_t width;
+	uint16_t height;
+} trace_screen_t;
+
+/* sized like a record, so it shares the ring with the events */
+typedef struct {
+	uint8_t response_type;
+	uint8_t kind;
+	uint8_t type;
+	uint8_t protocols;
+	xcb_window_t window;
+	xcb_window_t root;
+
+	int16_t x;
+	int16_t y;
+	uint16_t width;
+	uint16_t height;
+
+	int16_t ptr_x;
+	int16_t ptr_y;
+	uint32_t strut[4];
+} trace_reply_t;
+
+//class, then role, each cut short to fit
+typedef struct {
+	uint8_t response_type;
+	uint8_t kind;
+	char names[38];
+} trace_names_t;
+
+int trace_record_open(const char *path);
+void trace_add_screen(xcb_window_t root, uint16_t width, uint16_t height);
+void trace_record(xcb_generic_event_t *ev);
+void trace_record_reply(const void *reply);
+
+int trace_replay_open(const char *path);
+const trace_screen_t *trace_screens(unsigned int *len);
+xcb_generic_event_t *trace_replay(int fast);
+
+void trace_close(void);